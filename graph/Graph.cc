@@ -266,14 +266,20 @@ void Graph::draw_axes() {
   // TODO do something sane with additional variables
 }
 
-void Graph::plot(int v, double x, double y, bool link) {
-  if(v != current_variable && current_variable >= 0) {
+// Draw the line for the current variable, if there is one
+void Graph::stroke() {
+  if(current_variable >= 0) {
     context->set_source_rgb(variables[current_variable].r,
                             variables[current_variable].g,
                             variables[current_variable].b);
     context->stroke();
     current_variable = -1;
   }
+}
+
+void Graph::plot(int v, double x, double y, bool link) {
+  if(v != current_variable)
+    stroke();
   // If there was no previous point, we can't link to it
   if(current_variable < 0)
     link = false;
@@ -289,14 +295,20 @@ void Graph::plot(int v, double x, double y, bool link) {
   current_variable = v;
 }
 
+void Graph::error_bar(int v, double x, double low, double high) {
+  stroke();
+  context->set_source_rgba(variables[v].r, variables[v].g, variables[v].b,
+                           0.5);
+  context->move_to(xc(x), yc(v, low));
+  context->line_to(xc(x), yc(v, high));
+  context->move_to(xc(x) - mark_size / 2, yc(v, low));
+  context->line_to(xc(x) + mark_size / 2, yc(v, low));
+  context->move_to(xc(x) - mark_size / 2, yc(v, high));
+  context->line_to(xc(x) + mark_size / 2, yc(v, high));
+  context->stroke();
+}
+
 void Graph::save(const std::string &path) {
-  if(current_variable >= 0) {
-    // TODO de-dupe
-    context->set_source_rgb(variables[current_variable].r,
-                            variables[current_variable].g,
-                            variables[current_variable].b);
-    context->stroke();
-    current_variable = -1;
-  }
+  stroke();
   surface->write_to_png(path);
 }
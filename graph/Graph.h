@@ -68,6 +68,10 @@ public:
   // axis (same 'v' value).
   void plot(int v, double x, double y, bool link = false);
 
+  // Draw an error bar from LOW to HIGH at X.  Call any number of times, but
+  // before any plot() calls for the same Y axis.
+  void error_bar(int v, double x, double low, double high);
+
   // Save as a PNG
   void save(const std::string &path);
 
@@ -109,6 +113,7 @@ private:
 
   void compute_bounds();
   void draw_axes();
+  void stroke();
 };
 
 #endif /* GRAPH_H */
@@ -73,4 +73,9 @@ std::string round_kilo(double n);
 void read_file(const std::string &path, std::vector<std::string> &lines);
 void write_file(const std::string &path, std::vector<std::string> &lines);
 
+uint64_t hash64(const char *s, size_t len);
+inline uint64_t hash64(const std::string &s) {
+  return hash64(s.data(), s.size());
+}
+
 #endif /* CPPUTILS */
@@ -0,0 +1,39 @@
+/*
+ * This file is part of rjk-nntp-tools
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include <config.h>
+#include "cpputils.h"
+
+/* Return a 64-bit hash of the LEN bytes at S.  This is FNV-1a followed by a
+ * finalizer so that every bit of the result depends on every bit of the
+ * input; callers may use any subset of the bits (e.g. for sharding or
+ * sampling).  It is not a cryptographic hash. */
+uint64_t hash64(const char *s, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(size_t n = 0; n < len; ++n) {
+    h ^= (unsigned char)s[n];
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
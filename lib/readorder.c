@@ -0,0 +1,80 @@
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright © 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include <config.h>
+#include "readorder.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#if HAVE_LINUX_FIEMAP_H
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+
+int parse_read_order(const char *s) {
+  if(!strcmp(s, "directory"))
+    return read_order_directory;
+  if(!strcmp(s, "inode"))
+    return read_order_inode;
+  if(!strcmp(s, "physical"))
+    return read_order_physical;
+  return -1;
+}
+
+/* Keys for files whose physical location is unknown have this bit set, so
+ * that they sort after the rest (in inode order) rather than among them.
+ * Physical offsets are in bytes so never get near it. */
+#define UNKNOWN_LOCATION ((uint64_t)1 << 63)
+
+/* Return the physical offset of the start of NAME in directory DIRFD, or
+ * fall back to its inode number INO if that cannot be found */
+static uint64_t physical_offset(int dirfd, const char *name, ino_t ino) {
+#if HAVE_LINUX_FIEMAP_H && defined FS_IOC_FIEMAP
+  struct {
+    struct fiemap fm;
+    struct fiemap_extent extent;
+  } map;
+  int fd;
+
+  if((fd = openat(dirfd, name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK)) < 0)
+    return UNKNOWN_LOCATION | ino;
+  memset(&map, 0, sizeof map);
+  map.fm.fm_length = ~(uint64_t)0;
+  map.fm.fm_extent_count = 1;
+  if(ioctl(fd, FS_IOC_FIEMAP, &map.fm) < 0 || map.fm.fm_mapped_extents == 0) {
+    close(fd);
+    return UNKNOWN_LOCATION | ino;
+  }
+  close(fd);
+  return map.fm.fm_extents[0].fe_physical;
+#else
+  (void)dirfd;
+  (void)name;
+  return UNKNOWN_LOCATION | ino;
+#endif
+}
+
+uint64_t read_order_key(int order, int dirfd, const char *name, ino_t ino) {
+  switch(order) {
+  case read_order_inode: return ino;
+  case read_order_physical: return physical_offset(dirfd, name, ino);
+  default: return 0;
+  }
+}
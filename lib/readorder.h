@@ -0,0 +1,51 @@
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright © 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+
+#ifndef READORDER_H
+#define READORDER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Read-scheduling policies for walking a spool */
+
+enum read_order {
+  read_order_directory, /* order the directory lists them */
+  read_order_inode,     /* inode number order */
+  read_order_physical   /* physical order on disk where known, then inode */
+};
+
+/* Parse a read order name, returning -1 if it is not valid */
+int parse_read_order(const char *s);
+
+/* Return the key by which to sort NAME (with inode INO) in directory DIRFD
+ * for reading in ORDER.  With read_order_directory the key is always 0, so
+ * a stable sort leaves the order alone. */
+uint64_t read_order_key(int order, int dirfd, const char *name, ino_t ino);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* READORDER_H */
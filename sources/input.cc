@@ -0,0 +1,595 @@
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include <config.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_LZMA
+#include <lzma.h>
+#endif
+#if HAVE_BZLIB
+#include <bzlib.h>
+#endif
+#if HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "utils.h"
+#include "error.h"
+#include "input.h"
+
+// Size of each block of decompressed data, and how many there are
+#define BLOCK_SIZE (1024 * 1024)
+#define BLOCKS 4
+
+// Size of each read of compressed data
+#define COMPRESSED_BUFFER (256 * 1024)
+
+// Longest magic number
+#define MAGIC_MAX 6
+
+// Read up to N bytes from FD, retrying after interrupts
+static size_t read_some(int fd, char *buffer, size_t n,
+                        const std::string &name) {
+  ssize_t bytes;
+  while((bytes = read(fd, buffer, n)) < 0)
+    if(errno != EINTR)
+      fatal(errno, "reading %s", name.c_str());
+  return bytes;
+}
+
+// Uncompressed input, read directly
+class plain_input: public input {
+public:
+  plain_input(const std::string &name_, int fd_, const char *peeked,
+              size_t npeeked):
+      name(name_), fd(fd_), pending(peeked, peeked + npeeked) {}
+
+  ~plain_input() {
+    if(fd != STDIN_FILENO)
+      close(fd);
+  }
+
+  size_t read(char *buffer, size_t n) override {
+    if(pending.size()) {
+      // Return the bytes that were read to check the magic number
+      n = std::min(n, pending.size());
+      memcpy(buffer, pending.data(), n);
+      pending.erase(pending.begin(), pending.begin() + n);
+      return n;
+    }
+    return read_some(fd, buffer, n, name);
+  }
+
+private:
+  std::string name;
+  int fd;
+  std::vector<char> pending;
+};
+
+// A log file that is still being written, and may be rotated or truncated
+class following_input: public input {
+public:
+  following_input(const std::string &path_, std::function<void()> idle_):
+      path(path_), idle(idle_) {}
+
+  ~following_input() {
+    if(fd >= 0)
+      close(fd);
+  }
+
+  size_t read(char *buffer, size_t n) override {
+    for(;;) {
+      size_t bytes;
+      if(fd >= 0 && (bytes = read_some(fd, buffer, n, path))) {
+        offset += bytes;
+        return bytes;
+      }
+      // At the end of the file (or there isn't one yet).  If a different file
+      // now has the name then the log has been rotated, and the new one is
+      // read from the start; if it has shrunk it has been truncated.
+      struct stat sb;
+      if(stat(path.c_str(), &sb) == 0) {
+        if(fd < 0 || sb.st_dev != dev || sb.st_ino != ino) {
+          // Lines may have been added to the old file between reaching its
+          // end and it being renamed, so finish it before moving on
+          if(fd >= 0 && (bytes = read_some(fd, buffer, n, path))) {
+            offset += bytes;
+            return bytes;
+          }
+          if(reopen())
+            continue;
+        } else if(sb.st_size < offset) {
+          if(lseek(fd, 0, SEEK_SET) < 0)
+            fatal(errno, "seeking %s", path.c_str());
+          offset = 0;
+          continue;
+        }
+      }
+      idle();
+      sleep(1);
+    }
+  }
+
+private:
+  std::string path;
+  std::function<void()> idle;
+  int fd = -1;
+  dev_t dev = 0;
+  ino_t ino = 0;
+  off_t offset = 0;
+
+  // Open the file with the name, if there is one
+  bool reopen() {
+    int new_fd;
+    struct stat sb;
+    if((new_fd = open(path.c_str(), O_RDONLY)) < 0) {
+      if(errno == ENOENT)
+        return false;
+      fatal(errno, "opening %s", path.c_str());
+    }
+    if(fstat(new_fd, &sb) < 0)
+      fatal(errno, "stat %s", path.c_str());
+    if(fd >= 0)
+      close(fd);
+    fd = new_fd;
+    dev = sb.st_dev;
+    ino = sb.st_ino;
+    offset = 0;
+    return true;
+  }
+};
+
+// Input decompressed by an external command
+class command_input: public input {
+public:
+  command_input(const std::string &path, const char *command_):
+      name(path), command(command_) {
+    const char *const args[] = {command, "-cd", path.c_str(), NULL};
+    if(!(fp = popenvp("r", &pid, command, (char *const *)args)))
+      fatal(errno, "opening %s", path.c_str());
+  }
+
+  ~command_input() {
+    fclose(fp);
+    int w;
+    if(waitpid(pid, &w, 0) < 0)
+      fatal(errno, "waitpid");
+    if(w)
+      fatal(0, "%s -cd %s: wait status %#x", command, name.c_str(), w);
+  }
+
+  size_t read(char *buffer, size_t n) override {
+    return read_some(fileno(fp), buffer, n, name);
+  }
+
+private:
+  std::string name;
+  const char *command;
+  FILE *fp;
+  pid_t pid;
+};
+
+// A decompression algorithm
+class codec {
+public:
+  codec(const std::string &name_): name(name_) {}
+
+  virtual ~codec() = default;
+
+  // Decompress from IN_LEN bytes at IN to OUT_LEN bytes at OUT, setting
+  // CONSUMED and PRODUCED to the number of bytes used.  LAST is set if no
+  // more input follows.  Returns true at the end of a compressed stream.
+  // Errors are fatal.
+  virtual bool step(const char *in, size_t in_len, size_t &consumed, char *out,
+                    size_t out_len, size_t &produced, bool last) = 0;
+
+  // Start a new stream (a concatenated file has several)
+  virtual void reset() = 0;
+
+protected:
+  std::string name; // file being decompressed
+};
+
+#if HAVE_ZLIB
+class gzip_codec: public codec {
+public:
+  gzip_codec(const std::string &name_): codec(name_) {
+    memset(&z, 0, sizeof z);
+    // +16 selects the gzip format
+    if(inflateInit2(&z, 15 + 16) != Z_OK)
+      fatal(0, "%s: inflateInit2 failed", name.c_str());
+  }
+
+  ~gzip_codec() {
+    inflateEnd(&z);
+  }
+
+  bool step(const char *in, size_t in_len, size_t &consumed, char *out,
+            size_t out_len, size_t &produced, bool) override {
+    z.next_in = (Bytef *)in;
+    z.avail_in = in_len;
+    z.next_out = (Bytef *)out;
+    z.avail_out = out_len;
+    const int rc = inflate(&z, Z_NO_FLUSH);
+    consumed = in_len - z.avail_in;
+    produced = out_len - z.avail_out;
+    if(rc == Z_STREAM_END)
+      return true;
+    if(rc != Z_OK && rc != Z_BUF_ERROR)
+      fatal(0, "%s: %s", name.c_str(), z.msg ? z.msg : "corrupt gzip data");
+    return false;
+  }
+
+  void reset() override {
+    inflateReset(&z);
+  }
+
+private:
+  z_stream z;
+};
+#endif
+
+#if HAVE_LZMA
+class xz_codec: public codec {
+public:
+  xz_codec(const std::string &name_): codec(name_) {
+    init();
+  }
+
+  ~xz_codec() {
+    lzma_end(&s);
+  }
+
+  bool step(const char *in, size_t in_len, size_t &consumed, char *out,
+            size_t out_len, size_t &produced, bool last) override {
+    s.next_in = (const uint8_t *)in;
+    s.avail_in = in_len;
+    s.next_out = (uint8_t *)out;
+    s.avail_out = out_len;
+    const lzma_ret rc = lzma_code(&s, last ? LZMA_FINISH : LZMA_RUN);
+    consumed = in_len - s.avail_in;
+    produced = out_len - s.avail_out;
+    if(rc == LZMA_STREAM_END)
+      return true;
+    if(rc != LZMA_OK && rc != LZMA_BUF_ERROR)
+      fatal(0, "%s: corrupt xz data (error %d)", name.c_str(), (int)rc);
+    return false;
+  }
+
+  void reset() override {
+    lzma_end(&s);
+    init();
+  }
+
+private:
+  lzma_stream s;
+
+  void init() {
+    s = LZMA_STREAM_INIT;
+    // Concatenated streams are handled by liblzma itself
+    if(lzma_stream_decoder(&s, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+      fatal(0, "%s: lzma_stream_decoder failed", name.c_str());
+  }
+};
+#endif
+
+#if HAVE_BZLIB
+class bzip2_codec: public codec {
+public:
+  bzip2_codec(const std::string &name_): codec(name_) {
+    init();
+  }
+
+  ~bzip2_codec() {
+    BZ2_bzDecompressEnd(&s);
+  }
+
+  bool step(const char *in, size_t in_len, size_t &consumed, char *out,
+            size_t out_len, size_t &produced, bool) override {
+    s.next_in = (char *)in;
+    s.avail_in = in_len;
+    s.next_out = out;
+    s.avail_out = out_len;
+    const int rc = BZ2_bzDecompress(&s);
+    consumed = in_len - s.avail_in;
+    produced = out_len - s.avail_out;
+    if(rc == BZ_STREAM_END)
+      return true;
+    if(rc != BZ_OK)
+      fatal(0, "%s: corrupt bzip2 data (error %d)", name.c_str(), rc);
+    return false;
+  }
+
+  void reset() override {
+    BZ2_bzDecompressEnd(&s);
+    init();
+  }
+
+private:
+  bz_stream s;
+
+  void init() {
+    memset(&s, 0, sizeof s);
+    if(BZ2_bzDecompressInit(&s, 0, 0) != BZ_OK)
+      fatal(0, "%s: BZ2_bzDecompressInit failed", name.c_str());
+  }
+};
+#endif
+
+#if HAVE_ZSTD
+class zstd_codec: public codec {
+public:
+  zstd_codec(const std::string &name_): codec(name_) {
+    if(!(s = ZSTD_createDStream()))
+      fatal(0, "%s: ZSTD_createDStream failed", name.c_str());
+    reset();
+  }
+
+  ~zstd_codec() {
+    ZSTD_freeDStream(s);
+  }
+
+  bool step(const char *in, size_t in_len, size_t &consumed, char *out,
+            size_t out_len, size_t &produced, bool) override {
+    ZSTD_inBuffer ib = {in, in_len, 0};
+    ZSTD_outBuffer ob = {out, out_len, 0};
+    const size_t rc = ZSTD_decompressStream(s, &ob, &ib);
+    if(ZSTD_isError(rc))
+      fatal(0, "%s: %s", name.c_str(), ZSTD_getErrorName(rc));
+    consumed = ib.pos;
+    produced = ob.pos;
+    // 0 means a frame is complete and fully flushed
+    return rc == 0;
+  }
+
+  void reset() override {
+    ZSTD_initDStream(s);
+  }
+
+private:
+  ZSTD_DStream *s;
+};
+#endif
+
+// Input decompressed by a codec.  Decompression runs in its own thread,
+// filling a small pool of blocks that read() takes in turn, so that it
+// overlaps with parsing.
+class decompressing_input: public input {
+public:
+  decompressing_input(const std::string &name_, int fd_, codec *c_,
+                      const char *peeked, size_t npeeked):
+      name(name_), fd(fd_), c(c_), in(COMPRESSED_BUFFER) {
+    memcpy(in.data(), peeked, npeeked);
+    in_len = npeeked;
+    for(size_t n = 0; n < BLOCKS; ++n) {
+      blocks[n].data.resize(BLOCK_SIZE);
+      empty.push_back(&blocks[n]);
+    }
+    worker = std::thread(&decompressing_input::work, this);
+  }
+
+  ~decompressing_input() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+    if(fd != STDIN_FILENO)
+      close(fd);
+  }
+
+  size_t read(char *buffer, size_t n) override {
+    if(!reading || read_pos == reading->used) {
+      std::unique_lock<std::mutex> guard(lock);
+      if(reading) {
+        empty.push_back(reading);
+        reading = NULL;
+        changed.notify_all();
+      }
+      changed.wait(guard, [this] { return !full.empty() || finished; });
+      if(full.empty())
+        return 0;
+      reading = full.front();
+      full.pop_front();
+      read_pos = 0;
+    }
+    n = std::min(n, reading->used - read_pos);
+    memcpy(buffer, reading->data.data() + read_pos, n);
+    read_pos += n;
+    return n;
+  }
+
+private:
+  struct block {
+    std::vector<char> data;
+    size_t used = 0;
+  };
+
+  std::string name;
+  int fd;
+  std::unique_ptr<codec> c;
+
+  // Compressed data, owned by the worker
+  std::vector<char> in;
+  size_t in_pos = 0, in_len;
+
+  // Blocks waiting to be filled and waiting to be read, and the one being
+  // read.  All but reading and read_pos are protected by lock.
+  block blocks[BLOCKS];
+  std::deque<block *> empty, full;
+  bool finished = false;
+  bool stopping = false;
+  std::mutex lock;
+  std::condition_variable changed;
+  block *reading = NULL;
+  size_t read_pos = 0;
+
+  std::thread worker;
+
+  // Decompress the whole input
+  void work() {
+    bool input_ended = false, stream_ended = false, done = false;
+    while(!done) {
+      block *b;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [this] { return !empty.empty() || stopping; });
+        if(stopping)
+          return;
+        b = empty.front();
+        empty.pop_front();
+      }
+      b->used = 0;
+      while(b->used < b->data.size()) {
+        if(in_pos == in_len && !input_ended) {
+          in_pos = 0;
+          in_len = read_some(fd, in.data(), in.size(), name);
+          input_ended = !in_len;
+        }
+        if(stream_ended) {
+          if(in_pos == in_len && input_ended) {
+            done = true;
+            break;
+          }
+          // Another stream follows
+          c->reset();
+          stream_ended = false;
+        }
+        size_t consumed, produced;
+        stream_ended =
+            c->step(in.data() + in_pos, in_len - in_pos, consumed,
+                    b->data.data() + b->used, b->data.size() - b->used,
+                    produced, input_ended);
+        in_pos += consumed;
+        b->used += produced;
+        if(!stream_ended && !consumed && !produced && input_ended)
+          fatal(0, "%s: truncated compressed data", name.c_str());
+      }
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if(b->used)
+          full.push_back(b);
+        else
+          empty.push_back(b);
+        finished = done;
+      }
+      changed.notify_all();
+    }
+  }
+};
+
+// Compression formats, by magic number
+static const struct format {
+  const char *magic;
+  size_t len;
+  const char *command; // external command to decompress
+  codec *(*create)(const std::string &name);
+} formats[] = {
+    {"\x1f\x8b", 2, "gzip",
+#if HAVE_ZLIB
+     [](const std::string &name) -> codec * { return new gzip_codec(name); }
+#else
+     NULL
+#endif
+    },
+    {"\x1f\x9d", 2, "gzip", NULL}, // compress(1)
+    {"\xfd"
+     "7zXZ\0",
+     6, "xz",
+#if HAVE_LZMA
+     [](const std::string &name) -> codec * { return new xz_codec(name); }
+#else
+     NULL
+#endif
+    },
+    {"BZh", 3, "bzip2",
+#if HAVE_BZLIB
+     [](const std::string &name) -> codec * { return new bzip2_codec(name); }
+#else
+     NULL
+#endif
+    },
+    {"\x28\xb5\x2f\xfd", 4, "zstd",
+#if HAVE_ZSTD
+     [](const std::string &name) -> codec * { return new zstd_codec(name); }
+#else
+     NULL
+#endif
+    },
+};
+
+bool compressed(const char *data, size_t len) {
+  for(const format &f: formats)
+    if(len >= f.len && !memcmp(data, f.magic, f.len))
+      return true;
+  return false;
+}
+
+input *open_input(const std::string &path) {
+  int fd;
+  std::string name;
+  if(path == "-") {
+    fd = STDIN_FILENO;
+    name = "stdin";
+  } else {
+    if((fd = open(path.c_str(), O_RDONLY)) < 0)
+      fatal(errno, "opening %s", path.c_str());
+    name = path;
+  }
+  // Read enough to recognize any of the formats
+  char magic[MAGIC_MAX];
+  size_t nmagic = 0, bytes;
+  while(nmagic < MAGIC_MAX
+        && (bytes = read_some(fd, magic + nmagic, MAGIC_MAX - nmagic, name)))
+    nmagic += bytes;
+  for(const format &f: formats) {
+    if(nmagic < f.len || memcmp(magic, f.magic, f.len))
+      continue;
+    if(f.create)
+      return new decompressing_input(name, fd, f.create(name), magic, nmagic);
+    if(fd == STDIN_FILENO)
+      fatal(0, "cannot decompress %s data from stdin", f.command);
+    close(fd);
+    return new command_input(path, f.command);
+  }
+  return new plain_input(name, fd, magic, nmagic);
+}
+
+input *follow_input(const std::string &path, std::function<void()> idle) {
+  return new following_input(path, idle);
+}
@@ -0,0 +1,54 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// A source of (decompressed) log data
+class input {
+public:
+  virtual ~input() = default;
+
+  // Read up to N bytes into BUFFER.  Returns the number of bytes read, or 0
+  // at end of input.  Errors are fatal.
+  virtual size_t read(char *buffer, size_t n) = 0;
+};
+
+// Open PATH for reading, or standard input if it is "-".  Compressed input
+// is recognized by its magic number and decompressed, in a separate thread
+// where the library for the format is available, otherwise by running the
+// corresponding command (which only works for named files).
+input *open_input(const std::string &path);
+
+// Follow PATH, an uncompressed log file that is still being written, like
+// tail -F.  Reads wait for more data, calling IDLE about once a second while
+// there is none, and never reach the end.  If the file is replaced, then the
+// new one is read from the start once the old one is finished with.
+input *follow_input(const std::string &path, std::function<void()> idle);
+
+// Return true if the LEN bytes at DATA start with a compressed format's magic
+// number
+bool compressed(const char *data, size_t len);
+
+#endif /* INPUT_H */
@@ -19,29 +19,39 @@
  */
 #include <config.h>
 #include <algorithm>
+#include <atomic>
 #include <cairomm/cairomm.h>
 #include <cassert>
 #include <cerrno>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <fcntl.h>
 #include <getopt.h>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sigc++/bind.h>
 #include <string>
+#include <string_view>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
-#include <sys/wait.h>
+#include <thread>
+#include <tuple>
 #include <unistd.h>
+#include <unordered_map>
 
 #include "utils.h"
 #include "cpputils.h"
 #include "error.h"
 #include "listdir.h"
+#include "input.h"
+#include "statefile.h"
 
 // from art.c
 #define ART_ACCEPT '+'
@@ -50,21 +60,32 @@
 #define ART_JUNK 'j'
 #define ART_REJECT '-'
 
-struct map_entry {
-  uint64_t articles;
-  uint64_t bytes;
-};
-
-#define MAP_BUCKETS (60 * 24)
+// State files from before day files, one per peer per day (see migrate())
 #define MAP_SIZE (MAP_BUCKETS * sizeof(map_entry))
 #define MAP_EXTENSION ".nsdat"
 
+// Tiers of state, as numbered in the journal
+#define TIER_MINUTES 0 // a file for each day, by minute
+#define TIER_HOURS 1   // a file for each year, by hour
+#define TIER_DAYS 2    // a file for each year, by day
+#define TIERS 3
+
+// Number of files of each tier to keep open (see checkpoint())
+#define FILE_CACHE 8
+
+// Initial size of the input buffer
+#define READ_BUFFER (1024 * 1024)
+
+// Smallest chunk of a file to read in its own thread (see split_file())
+#define MIN_CHUNK (16 * 1024 * 1024)
+
 static struct tm start_time;
 static std::string state = ".";
 static std::string output = ".";
-static std::string current_path;
-static struct map_entry *current_map;
+static std::map<std::string, uint32_t, std::less<>> peer_ids;
 static struct timeval latest_time;
+static uint64_t latest_count; // articles counted at exactly latest_time
+static uint64_t latest_skip;  // of those, how many are still to be read
 static uint64_t time_counter;
 static std::set<std::string> days_changed;
 static double width = MAP_BUCKETS / 2;
@@ -73,6 +94,15 @@ static double margin = 64;
 static int svg;
 static std::string index_path = "index.html";
 static double trim;
+static unsigned jobs = 1;
+static uint64_t checkpoint_lines = 100000;
+static int checkpoint_interval = 10;
+static time_t next_checkpoint;
+static bool follow;
+static int render_interval = 60;
+static time_t next_render;
+static int keep_minutes; // days, or 0 to keep forever
+static int keep_hours;
 
 static const double colors[][3] = {
     {1.0, 0.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 1.0, 0.0},
@@ -100,32 +130,57 @@ static inline bool ends_with(const std::string &a, const std::string &b) {
           && a.compare(a.size() - b.size(), b.size(), b) == 0);
 }
 
-static bool process_file(FILE *fp);
+static void process_file(const std::string &path);
+static void process_files(const std::vector<std::string> &paths);
+static void follow_file(const std::string &path);
 static void process_line(const details &d);
 static void process_accepted(const details &d);
+static void close_days();
+static void migrate();
+static void check_state();
 static void read_timestamp();
-static void update_timestamp();
+static void write_timestamp();
+static void checkpoint();
+struct graph;
 static void process_day(const std::string &day);
-static void draw_graph(const std::string &day,
+static void process_week(const std::string &week);
+static void process_month(const std::string &month);
+static void process_year(const std::string &year);
+static void draw_graph(const graph &g,
                        const std::map<std::string, map_entry *> &info);
-static void draw_axes(Cairo::RefPtr<Cairo::Context> context, double max,
-                      double base, const std::string &title);
-static void fixup_html();
+static void draw_axes(Cairo::RefPtr<Cairo::Context> context, const graph &g,
+                      double max, double base, const std::string &title);
+static void render();
+static void expire();
+static void idle();
+static void fixup_html(const std::string &suffix, bool index);
 
 int main(int argc, char **argv) {
-  static const struct option options[] = {{"state", required_argument, 0, 's'},
-                                          {"output", required_argument, 0, 'o'},
-                                          {"type", required_argument, 0, 'T'},
-                                          {"index", required_argument, 0, 'i'},
-                                          {"size", required_argument, 0, 'S'},
-                                          {"trim", required_argument, 0, 't'},
-                                          {"help", no_argument, 0, 'h'},
-                                          {"version", no_argument, 0, 'V'},
-                                          {0, 0, 0, 0}};
+  static const struct option options[] = {
+      {"state", required_argument, 0, 's'},
+      {"output", required_argument, 0, 'o'},
+      {"type", required_argument, 0, 'T'},
+      {"index", required_argument, 0, 'i'},
+      {"size", required_argument, 0, 'S'},
+      {"trim", required_argument, 0, 't'},
+      {"jobs", required_argument, 0, 'j'},
+      {"checkpoint-lines", required_argument, 0, 'c'},
+      {"checkpoint-interval", required_argument, 0, 'C'},
+      {"follow", no_argument, 0, 'f'},
+      {"render-interval", required_argument, 0, 'r'},
+      {"keep-minutes", required_argument, 0, 'k'},
+      {"keep-hours", required_argument, 0, 'K'},
+      {"migrate", no_argument, 0, 'M'},
+      {"help", no_argument, 0, 'h'},
+      {"version", no_argument, 0, 'V'},
+      {0, 0, 0, 0}};
 
   int n;
+  bool migrate_only = false;
 
-  while((n = getopt_long(argc, argv, "hVs:o:T:i:S:t:", options, 0)) >= 0) {
+  while((n = getopt_long(argc, argv, "hVs:o:T:i:S:t:j:c:C:fr:k:K:M", options,
+                         0))
+        >= 0) {
     switch(n) {
     case 'h':
       printf("Usage:\n\
@@ -138,6 +193,14 @@ Options:\n\
   -i, --index PATH                  Index filename (defaut: index.html)\n\
   -S, --size WIDTHxHEIGHT           Graph size (default: 720x256)\n\
   -t, --trim PERCENTILE             Trim top end of data (default: 1)\n\
+  -j, --jobs N                      Threads to read input with (default: 1)\n\
+  -c, --checkpoint-lines N          Articles per checkpoint (default: 100000)\n\
+  -C, --checkpoint-interval SECONDS Seconds per checkpoint (default: 10)\n\
+  -f, --follow                      Follow a log file as it is written\n\
+  -r, --render-interval SECONDS     Time between graphs (default: 60)\n\
+  -k, --keep-minutes DAYS           Days to keep counts by minute\n\
+  -K, --keep-hours DAYS             Days to keep counts by hour\n\
+  -M, --migrate                     Convert old state files and exit\n\
   -h, --help                        Display usage message\n\
   -V, --version                     Display version number\n");
       return 0;
@@ -167,6 +230,34 @@ Options:\n\
       if(trim < 0 || trim > 100)
         fatal(0, "trim value out of range");
       break;
+    case 'j':
+      if(atoi(optarg) < 1)
+        fatal(0, "invalid argument to --jobs option");
+      jobs = atoi(optarg);
+      break;
+    case 'c':
+      if(atoll(optarg) < 1)
+        fatal(0, "invalid argument to --checkpoint-lines option");
+      checkpoint_lines = atoll(optarg);
+      break;
+    case 'C':
+      if((checkpoint_interval = atoi(optarg)) < 0)
+        fatal(0, "invalid argument to --checkpoint-interval option");
+      break;
+    case 'f': follow = true; break;
+    case 'r':
+      if((render_interval = atoi(optarg)) < 0)
+        fatal(0, "invalid argument to --render-interval option");
+      break;
+    case 'k':
+      if((keep_minutes = atoi(optarg)) < 0)
+        fatal(0, "invalid argument to --keep-minutes option");
+      break;
+    case 'K':
+      if((keep_hours = atoi(optarg)) < 0)
+        fatal(0, "invalid argument to --keep-hours option");
+      break;
+    case 'M': migrate_only = true; break;
     default: return 1;
     }
   }
@@ -178,80 +269,113 @@ Options:\n\
   if(!localtime_r(&now.tv_sec, &start_time))
     fatal(errno, "localtime_r");
 
+  if(migrate_only) {
+    migrate();
+    return 0;
+  }
+  check_state();
+
   // Read the last-processed timestamp.  Any older records are ignored.
   read_timestamp();
 
   // Read the input.
-  if(optind < argc) {
-    while(optind < argc) {
-      if(!strcmp(argv[optind], "-")) {
-        if(!process_file(stdin))
-          fatal(errno, "reading stdin");
-      } else if(ends_with(argv[optind], ".gz")
-                || ends_with(argv[optind], ".Z")) {
-        std::vector<const char *> command;
-        command.push_back("gzip");
-        command.push_back("-cd");
-        command.push_back(argv[optind]);
-        command.push_back(NULL);
-        pid_t pid;
-        FILE *fp = popenvp("r", &pid, command[0], (char *const *)&command[0]);
-        if(!fp)
-          fatal(errno, "opening %s", argv[optind]);
-        if(!process_file(fp))
-          fatal(errno, "reading %s", argv[optind]);
-        fclose(fp);
-        int w;
-        if(waitpid(pid, &w, 0) < 0)
-          fatal(errno, "waitpid");
-        if(w)
-          fatal(0, "%s: wait status %#x", command[0], w);
-      } else {
-        FILE *fp = fopen(argv[optind], "r");
-        if(!fp)
-          fatal(errno, "opening %s", argv[optind]);
-        if(!process_file(fp))
-          fatal(errno, "reading %s", argv[optind]);
-        fclose(fp);
-      }
-      ++optind;
-    }
-  } else {
-    if(!process_file(stdin))
-      fatal(errno, "reading stdin");
+  if(follow) {
+    if(argc - optind != 1)
+      fatal(0, "--follow requires exactly one input");
+    follow_file(argv[optind]);
+  } else if(jobs > 1 && optind < argc)
+    process_files(std::vector<std::string>(argv + optind, argv + argc));
+  else if(optind < argc) {
+    while(optind < argc)
+      process_file(argv[optind++]);
+  } else
+    process_file("-");
+
+  // Commit the counts and the last-processed timestamp.
+  checkpoint();
+  close_days();
+
+  render();
+  expire();
+  return 0;
+}
+
+// Read lines from an input a large block at a time, or from a region of
+// memory.  Lines are found with memchr() and returned as views into the
+// buffer (or the memory), so there is no per-line copying or allocation.
+class line_reader {
+public:
+  line_reader(input &in_): in(&in_), buffer(READ_BUFFER) {
+    data = buffer.data();
   }
 
-  // Commit the last-processed timestamp.
-  update_timestamp();
+  line_reader(const char *begin, const char *end_):
+      in(NULL), data(begin), end(end_ - begin) {}
 
-  // Render graphs for every day for which new data was gathered.
-  std::for_each(days_changed.begin(), days_changed.end(), process_day);
+  // Get the next line, without its newline.  The view is valid until the
+  // next call.  Returns false at end of input, discarding any unterminated
+  // last line.
+  bool next(std::string_view &line) {
+    for(;;) {
+      const char *nl =
+          (const char *)memchr(data + scanned, '\n', end - scanned);
+      if(nl) {
+        line = std::string_view(data + start, nl - (data + start));
+        start = scanned = nl - data + 1;
+        return true;
+      }
+      scanned = end;
+      if(!fill())
+        return false;
+    }
+  }
 
-  // Fix up links & index
-  fixup_html();
+private:
+  input *in; // NULL when reading from memory
+  std::vector<char> buffer;
+  const char *data;   // buffer or memory
+  size_t start = 0;   // start of the current line
+  size_t scanned = 0; // bytes already searched for a newline
+  size_t end = 0;     // end of the data
 
-  return 0;
-}
+  // Read more data.  Returns false at end of input.
+  bool fill() {
+    if(!in)
+      return false;
+    if(start > 0) {
+      // Move the incomplete line to the front
+      memmove(buffer.data(), buffer.data() + start, end - start);
+      end -= start;
+      scanned -= start;
+      start = 0;
+    }
+    if(end == buffer.size()) {
+      buffer.resize(2 * buffer.size());
+      data = buffer.data();
+    }
+    const size_t n = in->read(buffer.data() + end, buffer.size() - end);
+    end += n;
+    return n > 0;
+  }
+};
 
 // General-purpose line parser
 class parser {
 public:
-  std::string line;
+  std::string_view line;
   size_t pos;
   size_t limit;
 
-  bool input(FILE *fp) {
-    int ch;
-    line.clear();
-    while((ch = getc(fp)) >= 0 && ch != '\n')
-      line += ch;
+  bool input(line_reader &r) {
+    if(!r.next(line))
+      return false;
     pos = 0;
     limit = line.size();
-    return ch != EOF;
+    return true;
   }
 
   bool is(char c) {
-    if(pos < limit && line.at(pos) == c) {
+    if(pos < limit && line[pos] == c) {
       ++pos;
       return true;
     } else
@@ -260,7 +384,7 @@ public:
 
   bool is(const char *s) {
     size_t len_s = strlen(s);
-    if(line.compare(pos, len_s, s, len_s) == 0) {
+    if(limit - pos >= len_s && memcmp(line.data() + pos, s, len_s) == 0) {
       pos += len_s;
       return true;
     } else
@@ -268,14 +392,14 @@ public:
   }
 
   void skip_spaces() {
-    while(pos < limit && isspace(line.at(pos)))
+    while(pos < limit && isspace((unsigned char)line[pos]))
       ++pos;
   }
 
   bool get_char(int &ch) {
     skip_spaces();
     if(pos < limit) {
-      ch = line.at(pos++);
+      ch = line[pos++];
       return true;
     } else
       return false;
@@ -284,21 +408,23 @@ public:
   bool get_int(int &n) {
     skip_spaces();
     n = 0;
-    if(pos < limit && isdigit(line.at(pos))) {
-      while(pos < limit && isdigit(line.at(pos)))
-        n = 10 * n + line.at(pos++) - '0';
+    if(pos < limit && isdigit((unsigned char)line[pos])) {
+      while(pos < limit && isdigit((unsigned char)line[pos]))
+        n = 10 * n + line[pos++] - '0';
       return true;
     } else
       return false;
   }
 
-  bool get_string(std::string &s) {
+  // Get a token as a view into the line
+  bool get_string(std::string_view &s) {
     skip_spaces();
-    s.clear();
     if(pos >= limit)
       return false;
-    while(pos < limit && !isspace(line.at(pos)))
-      s += line.at(pos++);
+    const size_t begin = pos;
+    while(pos < limit && !isspace((unsigned char)line[pos]))
+      ++pos;
+    s = line.substr(begin, pos - begin);
     return true;
   }
 };
@@ -309,10 +435,10 @@ public:
   struct tm when;
   struct timeval when_time;
   int code;
-  std::string peer;
-  std::string message;
+  std::string_view peer;
+  std::string_view message;
   int size;
-  std::string extra;
+  std::string_view extra;
 
   bool parse(parser &p) {
     static const char *const months[] = {"Jan", "Feb", "Mar", "Apr",
@@ -353,25 +479,129 @@ public:
         return false;
     }
     p.skip_spaces();
-    extra.assign(p.line, p.pos, std::string::npos);
-    when.tm_year = start_time.tm_year;
-    if(when.tm_mon > start_time.tm_mon)
-      --when.tm_year;
-    when.tm_isdst = -1;
-    when_time.tv_sec = mktime(&when);
+    extra = p.line.substr(p.pos);
+    if(when.tm_mon != day.mon || when.tm_mday != day.mday
+       || start_time.tm_year != day.start_year
+       || start_time.tm_mon != day.start_mon)
+      new_day();
+    when.tm_year = day.year;
+    const bool in_range = when.tm_hour < 24 && when.tm_min < 60
+                          && when.tm_sec < 60 && day.exists;
+    if(day.simple && in_range)
+      when_time.tv_sec =
+          day.midnight + 3600 * when.tm_hour + 60 * when.tm_min + when.tm_sec;
+    else if(in_range)
+      when_time.tv_sec = clocks_changed_time();
+    else {
+      when.tm_isdst = -1;
+      when_time.tv_sec = mktime(&when);
+    }
     when_time.tv_usec = 1000 * msec;
+    last = when_time.tv_sec;
     return true;
   }
+
+  // The time of the previous line
+  time_t last = 0;
+
+private:
+  // The day of the last line parsed, so that the year and the time of
+  // midnight need only be worked out when it changes
+  struct {
+    int mon = -1, mday = 0;            // day in the log
+    int start_year = 0, start_mon = 0; // start_time when it was worked out
+    int year = 0;
+    time_t midnight = 0;
+    bool simple = false; // true if the time of day is seconds since midnight
+    bool exists = false; // false for dates such as Feb 30
+  } day;
+
+  // Return true if T has the same local time as when
+  bool same_time(const struct tm &t) const {
+    return t.tm_sec == when.tm_sec && t.tm_min == when.tm_min
+           && t.tm_hour == when.tm_hour && t.tm_mday == when.tm_mday;
+  }
+
+  // Work out the time of a line on a day when the clocks change.  mktime()
+  // on its own would resolve ambiguous times according to whatever it was
+  // last asked, so both possibilities are tried.  A time that happens twice,
+  // when the clocks go back, is taken to be the first unless that is before
+  // the previous line.  One that doesn't happen, when they go forward, is
+  // taken to be in the old offset, which puts it after the change.
+  time_t clocks_changed_time() {
+    struct tm standard = when, summer = when;
+    standard.tm_isdst = 0;
+    summer.tm_isdst = 1;
+    const time_t ts = mktime(&standard), tu = mktime(&summer);
+    const time_t first = std::min(ts, tu), second = std::max(ts, tu);
+    time_t t;
+    if(same_time(standard) && same_time(summer))
+      t = first < last ? second : first;
+    else if(same_time(standard))
+      t = ts;
+    else if(same_time(summer))
+      t = tu;
+    else
+      t = second;
+    if(!localtime_r(&t, &when))
+      fatal(errno, "localtime_r");
+    return t;
+  }
+
+  void new_day() {
+    day.mon = when.tm_mon;
+    day.mday = when.tm_mday;
+    day.start_year = start_time.tm_year;
+    day.start_mon = start_time.tm_mon;
+    day.year = start_time.tm_year;
+    if(when.tm_mon > start_time.tm_mon)
+      --day.year;
+    struct tm midnight, next;
+    memset(&midnight, 0, sizeof midnight);
+    midnight.tm_year = day.year;
+    midnight.tm_mon = when.tm_mon;
+    midnight.tm_mday = when.tm_mday;
+    midnight.tm_isdst = -1;
+    next = midnight;
+    ++next.tm_mday;
+    day.midnight = mktime(&midnight);
+    // If the clocks change during the day (or at midnight), or the date is
+    // out of range, leave it to mktime()
+    day.exists = midnight.tm_mday == when.tm_mday
+                 && midnight.tm_mon == when.tm_mon;
+    day.simple = day.exists && day.midnight != -1
+                 && mktime(&next) - day.midnight == 86400
+                 && midnight.tm_hour == 0;
+  }
 };
 
-static bool process_file(FILE *fp) {
+// Parse every line from R, calling F for each.  LAST is the time of the
+// line before R, if known.
+template <typename F>
+static void parse_lines(line_reader &r, F f, time_t last = 0) {
   details d;
+  d.last = last;
   parser p;
-  while(p.input(fp)) {
+  while(p.input(r)) {
     if(d.parse(p))
-      process_line(d);
+      f(d);
   }
-  return !ferror(fp);
+}
+
+static void process_file(const std::string &path) {
+  std::unique_ptr<input> in(open_input(path));
+  line_reader r(*in);
+  parse_lines(r, process_line, latest_time.tv_sec);
+}
+
+// Process PATH as it is written, rendering graphs as it changes.  Never
+// returns.
+static void follow_file(const std::string &path) {
+  next_render = time(NULL);
+  std::unique_ptr<input> in(follow_input(path, idle));
+  line_reader r(*in);
+  parse_lines(r, process_line, latest_time.tv_sec);
+  fatal(0, "%s: unexpected end of input", path.c_str());
 }
 
 static void process_line(const details &d) {
@@ -383,6 +613,7 @@ static void process_line(const details &d) {
   }
 }
 
+// Map an old state file (see migrate())
 static map_entry *open_map(const std::string &path) {
   int fd;
   if((fd = open(path.c_str(), O_RDWR | O_CREAT, 0666)) < 0)
@@ -399,43 +630,431 @@ static map_entry *open_map(const std::string &path) {
 
 static void close_map(struct map_entry *map) {
   if(map) {
-    if(munmap(current_map, MAP_SIZE) < 0)
+    if(munmap(map, MAP_SIZE) < 0)
       fatal(errno, "munmap");
   }
 }
 
-static void process_accepted(const details &d) {
-  char day[32];
-  snprintf(day, sizeof day, "%04d-%02d-%02d", d.when.tm_year + 1900,
-           d.when.tm_mon + 1, d.when.tm_mday);
-  std::string path = state + "/" + day + "-";
-  for(size_t pos = 0; pos < d.peer.size(); ++pos) {
-    if(d.peer.at(pos) > ' ' && d.peer.at(pos) < 0x7F)
-      path += d.peer.at(pos);
-    else
-      path += 'X';
+// Return the ID of PEER in IDS, adding it if necessary
+static uint32_t peer_id(std::string_view peer,
+                        std::map<std::string, uint32_t, std::less<>> &ids) {
+  auto it = ids.find(peer);
+  if(it == ids.end())
+    it = ids.emplace(std::string(peer), ids.size()).first;
+  return it->second;
+}
+
+// Identify the map for D by its day and the ID of its peer in IDS.  The day
+// number is in the top 32 bits and increases with the date.
+static uint64_t map_key(const details &d,
+                        std::map<std::string, uint32_t, std::less<>> &ids) {
+  const uint32_t day =
+      (d.when.tm_year * 12 + d.when.tm_mon) * 32 + d.when.tm_mday;
+  return (uint64_t)day << 32 | peer_id(d.peer, ids);
+}
+
+// Convert a day number from map_key() to a date
+static void day_name(uint32_t number, char (&day)[32]) {
+  snprintf(day, sizeof day, "%04u-%02u-%02u", number / (12 * 32) + 1900,
+           number / 32 % 12 + 1, number % 32);
+}
+
+static bool leap_year(int year) {
+  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static int days_in_year(int year) {
+  return leap_year(year) ? 366 : 365;
+}
+
+// MONTH counts from 1
+static int days_in_month(int year, int month) {
+  static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return days[month - 1] + (month == 2 && leap_year(year));
+}
+
+// Return the day of the year of YEAR-MONTH-DAY, counting from 0
+static int day_of_year(int year, int month, int day) {
+  int yday = day - 1;
+  for(int m = 1; m < month; ++m)
+    yday += days_in_month(year, m);
+  return yday;
+}
+
+// Open state files of each tier, indexed by the top half of map_key() for
+// day files and by year for the others
+static std::map<uint32_t, std::unique_ptr<state_file>> open_files[TIERS];
+
+static const state_format *const tier_formats[TIERS] = {
+    &minute_format, &hour_format, &day_format};
+static const char *const tier_extensions[TIERS] = {
+    DAY_EXTENSION, HOURS_EXTENSION, DAYS_EXTENSION};
+
+// A row of an open day file, its rows in the year's totals, and the counts
+// to add at the next checkpoint, by minute
+struct open_row {
+  state_file *file;
+  size_t row;
+  size_t hour_row, day_row;
+  std::vector<std::pair<uint32_t, map_entry>> pending;
+};
+static std::unordered_map<uint64_t, open_row> row_index;
+
+// Find the file of tier TIER for KEY.  Files are only closed by
+// checkpoint(), since until then counts may be pending for them.
+static state_file *find_file(int tier, uint32_t key) {
+  auto it = open_files[tier].find(key);
+  if(it != open_files[tier].end())
+    return it->second.get();
+  char name[32];
+  if(tier == TIER_MINUTES)
+    day_name(key, name);
+  else
+    snprintf(name, sizeof name, "%u", key);
+  state_file *f = new state_file(state + "/" + name + tier_extensions[tier],
+                                 *tier_formats[tier], true);
+  open_files[tier][key].reset(f);
+  return f;
+}
+
+// Find the row for PEER on the day in the top half of KEY, which is from
+// map_key().  The position of each peer's rows is remembered, so the name is
+// only looked up the first time.
+static open_row &find_row(uint64_t key, std::string_view peer) {
+  auto it = row_index.find(key);
+  if(it == row_index.end()) {
+    const uint32_t number = key >> 32, year = number / (12 * 32) + 1900;
+    const std::string name = peer_name(peer);
+    // The year's files are created first, so that a day file is never
+    // without them (see check_state())
+    const size_t day_row = find_file(TIER_DAYS, year)->find(name);
+    const size_t hour_row = find_file(TIER_HOURS, year)->find(name);
+    state_file *f = find_file(TIER_MINUTES, number);
+    const size_t row = f->find(name);
+    it = row_index.emplace(key, open_row{f, row, hour_row, day_row, {}}).first;
   }
-  path += MAP_EXTENSION;
-  if(path != current_path) {
-    close_map(current_map);
-    current_map = open_map(path);
-    current_path = path;
+  return it->second;
+}
+
+// Add ARTICLES and BYTES to minute MINUTE of R at the next checkpoint.  The
+// log is in time order, so usually the minute is the same as last time.
+static void count(open_row &r, uint32_t minute, uint64_t articles,
+                  uint64_t bytes) {
+  if(r.pending.empty() || r.pending.back().first != minute)
+    r.pending.push_back(std::make_pair(minute, map_entry{0, 0}));
+  r.pending.back().second.articles += articles;
+  r.pending.back().second.bytes += bytes;
+}
+
+// Close all the files opened by find_file()
+static void close_days() {
+  row_index.clear();
+  for(int tier = 0; tier < TIERS; ++tier)
+    open_files[tier].clear();
+}
+
+static void process_accepted(const details &d) {
+  // Articles at the high-water mark may have been counted by the last run
+  if(latest_skip && !(latest_time < d.when_time)) {
+    --latest_skip;
+    return;
   }
-  current_map[60 * d.when.tm_hour + d.when.tm_min].articles += 1;
-  current_map[60 * d.when.tm_hour + d.when.tm_min].bytes += d.size;
+  count(find_row(map_key(d, peer_ids), d.peer),
+        60 * d.when.tm_hour + d.when.tm_min, 1, d.size);
   if(d.when_time.tv_sec >= 0) {
-    if(latest_time < d.when_time)
+    if(latest_time < d.when_time) {
       latest_time = d.when_time;
+      latest_count = latest_skip = 0;
+    }
+    ++latest_count;
   }
+  // Only look at the clock occasionally
   ++time_counter;
-  if(time_counter >= 32)
-    update_timestamp();
-  days_changed.insert(day);
+  if(time_counter >= checkpoint_lines
+     || (time_counter % 1024 == 0 && time(NULL) >= next_checkpoint))
+    checkpoint();
+}
+
+// A piece of the input for process_files(): either a whole file, or a
+// chunk of a large one that has been mapped into memory
+struct unit {
+  std::string path;
+  const char *begin = NULL, *end = NULL; // non-NULL for a chunk
+};
+
+// Parse every line of U, calling F for each.  LAST is as for parse_lines().
+template <typename F>
+static void parse_unit(const unit &u, F f, time_t last = 0) {
+  if(u.begin) {
+    line_reader r(u.begin, u.end);
+    parse_lines(r, f, last);
+  } else {
+    std::unique_ptr<input> in(open_input(u.path));
+    line_reader r(*in);
+    parse_lines(r, f, last);
+  }
+}
+
+// Add PATH to UNITS.  A large uncompressed file is mapped into memory and
+// split into up to JOBS chunks at line boundaries, so that they can be read
+// in parallel; the mapping is added to MAPS.
+static void split_file(const std::string &path, std::vector<unit> &units,
+                       std::vector<std::pair<void *, size_t>> &maps) {
+  unit u;
+  u.path = path;
+  int fd;
+  struct stat sb;
+  if(path == "-" || (fd = open(path.c_str(), O_RDONLY)) < 0) {
+    // Leave errors to be reported when it is read
+    units.push_back(u);
+    return;
+  }
+  if(fstat(fd, &sb) < 0)
+    fatal(errno, "stat %s", path.c_str());
+  const size_t size = sb.st_size;
+  const size_t chunks = std::min<size_t>(jobs, size / MIN_CHUNK);
+  void *ptr = MAP_FAILED;
+  if(S_ISREG(sb.st_mode) && chunks >= 2)
+    ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(ptr != MAP_FAILED && compressed((const char *)ptr, size)) {
+    munmap(ptr, size);
+    ptr = MAP_FAILED;
+  }
+  if(ptr == MAP_FAILED) {
+    units.push_back(u);
+    return;
+  }
+  madvise(ptr, size, MADV_SEQUENTIAL);
+  maps.push_back(std::make_pair(ptr, size));
+  const char *const base = (const char *)ptr;
+  u.end = base;
+  for(size_t n = 1; n <= chunks; ++n) {
+    u.begin = u.end;
+    u.end = base + size;
+    // Each chunk ends just after a newline
+    const char *nl;
+    if(n < chunks && (nl = (const char *)memchr(base + n * size / chunks, '\n',
+                                               size - n * size / chunks)))
+      u.end = std::max(u.begin, nl + 1);
+    units.push_back(u);
+  }
+}
+
+// The articles counted from one unit by process_files()
+struct unit_counts {
+  struct counted {
+    std::string peer; // as in the log
+    std::vector<map_entry> entries;
+  };
+  std::unordered_map<uint64_t, counted> maps; // by map_key()
+  std::map<std::string, uint32_t, std::less<>> peers;
+  struct timeval first = {0, 0};  // earliest counted article
+  struct timeval latest = {0, 0}; // high-water mark
+  uint64_t latest_count = 0;      // articles counted at the high-water mark
+  bool any = false;               // true if anything was counted
+  bool ready = false;
+};
+
+// Count the articles in U as if it were the first input
+static void count_unit(const unit &u, unit_counts &c) {
+  parse_unit(u, [&](const details &d) {
+    if(d.when_time < c.latest
+       || (d.code != ART_ACCEPT && d.code != ART_JUNK))
+      return;
+    unit_counts::counted &m = c.maps[map_key(d, c.peers)];
+    if(m.entries.empty()) {
+      m.peer = std::string(d.peer);
+      m.entries.resize(MAP_BUCKETS);
+    }
+    m.entries[60 * d.when.tm_hour + d.when.tm_min].articles += 1;
+    m.entries[60 * d.when.tm_hour + d.when.tm_min].bytes += d.size;
+    if(d.when_time.tv_sec >= 0) {
+      if(c.latest < d.when_time) {
+        c.latest = d.when_time;
+        c.latest_count = 0;
+      }
+      ++c.latest_count;
+    }
+    if(!c.any)
+      c.first = d.when_time;
+    c.any = true;
+  });
+}
+
+// Process PATHS using JOBS threads.  Large uncompressed files are split into
+// chunks (see split_file()).  Each file or chunk is counted separately, from
+// scratch, and the results are then added to the maps in order.
+//
+// This gives the same answer as processing the input serially.  An article
+// is counted when it is no earlier than the high-water mark, which is the
+// latest article counted so far, so the articles counted from a unit are in
+// time order.  If the first of them is no earlier than the high-water mark
+// left by the previous units, then all of them are counted; if the last is
+// earlier, then none are.  Otherwise (only when the input overlaps in time)
+// the unit is processed again serially.
+//
+// The year of each line is inferred from the time the program started, the
+// same for every unit.
+static void process_files(const std::vector<std::string> &paths) {
+  std::vector<unit> units;
+  std::vector<std::pair<void *, size_t>> maps;
+  for(size_t n = 0; n < paths.size(); ++n)
+    split_file(paths[n], units, maps);
+  std::vector<unit_counts> counts(units.size());
+  std::mutex lock;
+  std::condition_variable done;
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    size_t n;
+    while((n = next++) < units.size()) {
+      count_unit(units[n], counts[n]);
+      std::lock_guard<std::mutex> guard(lock);
+      counts[n].ready = true;
+      done.notify_all();
+    }
+  };
+  std::vector<std::thread> workers;
+  for(unsigned j = 0; j < std::min<size_t>(jobs, units.size()); ++j)
+    workers.push_back(std::thread(work));
+  for(size_t n = 0; n < units.size(); ++n) {
+    unit_counts &c = counts[n];
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done.wait(guard, [&] { return c.ready; });
+    }
+    if(c.any && !(c.latest < latest_time)) {
+      if(c.first < latest_time
+         || (latest_skip && !(latest_time < c.first)))
+        parse_unit(units[n], process_line, latest_time.tv_sec);
+      else {
+        for(auto &m: c.maps) {
+          const uint64_t day = m.first & 0xFFFFFFFF00000000;
+          open_row &r =
+              find_row(day | peer_id(m.second.peer, peer_ids), m.second.peer);
+          for(uint32_t i = 0; i < MAP_BUCKETS; ++i) {
+            if(m.second.entries[i].articles)
+              count(r, i, m.second.entries[i].articles,
+                    m.second.entries[i].bytes);
+          }
+        }
+        if(latest_time < c.latest)
+          latest_count = 0;
+        latest_count += c.latest_count;
+        latest_time = c.latest;
+        latest_skip = 0;
+      }
+    }
+    checkpoint();
+    c = unit_counts();
+  }
+  for(size_t j = 0; j < workers.size(); ++j)
+    workers[j].join();
+  for(size_t n = 0; n < maps.size(); ++n)
+    munmap(maps[n].first, maps[n].second);
+}
+
+// Wait until changes to the entries in directory PATH are on disk
+static void sync_directory(const std::string &path) {
+  int fd;
+  if((fd = open(path.c_str(), O_RDONLY)) < 0)
+    fatal(errno, "opening %s", path.c_str());
+  if(fsync(fd) < 0)
+    fatal(errno, "fsync %s", path.c_str());
+  close(fd);
+}
+
+// The journal written by checkpoint(), followed by its entries
+struct journal_header {
+  char magic[8]; // JOURNAL_MAGIC
+  int64_t sec;   // high-water mark
+  int64_t usec;
+  uint64_t count; // articles counted at the high-water mark
+  uint64_t entries;
+};
+
+// The new value of one count of one peer in a state file
+struct journal_entry {
+  uint32_t file; // day number as in map_key(), or year
+  uint32_t row;
+  uint32_t bucket;
+  uint32_t tier;
+  map_entry value;
+};
+
+#define JOURNAL_MAGIC "nsjrnl1\n"
+
+// Replace PATH with the LEN bytes at DATA.  The new contents are written
+// alongside and renamed into place, and are on disk before returning.
+static void replace_file(const std::string &path, const void *data,
+                         size_t len) {
+  const std::string tmp = path + ".new";
+  int fd;
+  if((fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    fatal(errno, "opening %s", tmp.c_str());
+  if(write(fd, data, len) != (ssize_t)len)
+    fatal(errno, "writing %s", tmp.c_str());
+  if(fsync(fd) < 0 || close(fd) < 0)
+    fatal(errno, "writing %s", tmp.c_str());
+  if(rename(tmp.c_str(), path.c_str()) < 0)
+    fatal(errno, "renaming %s", tmp.c_str());
+  const size_t slash = path.rfind('/');
+  sync_directory(slash == std::string::npos ? "." : path.substr(0, slash));
+}
+
+// Apply the changes in JOURNAL to the state files
+static void apply_journal(const std::vector<journal_entry> &journal) {
+  std::set<state_file *> changed;
+  for(const journal_entry &j: journal) {
+    if(j.tier >= TIERS)
+      fatal(0, "journal is corrupt");
+    state_file *f = find_file(j.tier, j.file);
+    if(j.row >= f->peers() || j.bucket >= f->format.buckets)
+      fatal(0, "journal does not match %s", f->path.c_str());
+    f->row(j.row)[j.bucket] = j.value;
+    if(changed.insert(f).second && j.tier == TIER_MINUTES) {
+      char day[32];
+      day_name(j.file, day);
+      days_changed.insert(day);
+    }
+  }
+  for(state_file *f: changed)
+    f->sync();
+}
+
+// Finish any checkpoint that was interrupted
+static void recover() {
+  int fd;
+  if((fd = open("journal", O_RDONLY)) < 0) {
+    if(errno == ENOENT)
+      return;
+    fatal(errno, "opening journal");
+  }
+  journal_header h;
+  std::vector<journal_entry> journal;
+  if(read(fd, &h, sizeof h) != sizeof h
+     || memcmp(h.magic, JOURNAL_MAGIC, sizeof h.magic))
+    fatal(0, "journal is corrupt");
+  journal.resize(h.entries);
+  const ssize_t len = h.entries * sizeof(journal_entry);
+  if(read(fd, journal.data(), len) != len)
+    fatal(0, "journal is corrupt");
+  close(fd);
+  apply_journal(journal);
+  latest_time.tv_sec = h.sec;
+  latest_time.tv_usec = h.usec;
+  latest_count = h.count;
+  write_timestamp();
+  if(unlink("journal") < 0)
+    fatal(errno, "removing journal");
+  close_days();
 }
 
 static void read_timestamp() {
   FILE *fp;
+  recover();
   time_counter = 0;
+  next_checkpoint = time(NULL) + checkpoint_interval;
   if(!(fp = fopen("timestamp", "r"))) {
     if(errno == ENOENT)
       return;
@@ -443,42 +1062,427 @@ static void read_timestamp() {
   }
   long long sec;
   long usec;
-  if(fscanf(fp, "%lld.%ld", &sec, &usec) != 2)
+  unsigned long long count = 0;
+  // Older versions did not record the count
+  if(fscanf(fp, "%lld.%ld %llu", &sec, &usec, &count) < 2)
     fatal(errno, "reading timestamp");
+  fclose(fp);
   latest_time.tv_sec = sec;
   latest_time.tv_usec = usec;
+  latest_count = latest_skip = count;
 }
 
-static void update_timestamp() {
-  FILE *fp;
-  if(!(fp = fopen("timestamp", "w")))
-    fatal(errno, "opening timestamp");
-  if(fprintf(fp, "%lld.%06ld\n", (long long)latest_time.tv_sec,
-             (long)latest_time.tv_usec)
-         < 0
-     || fclose(fp) < 0)
-    fatal(errno, "writing timestamp");
+static void write_timestamp() {
+  char buffer[64];
+  const int len =
+      snprintf(buffer, sizeof buffer, "%lld.%06ld %llu\n",
+               (long long)latest_time.tv_sec, (long)latest_time.tv_usec,
+               (unsigned long long)latest_count);
+  replace_file("timestamp", buffer, len);
+}
+
+// Commit the pending counts and the high-water mark.
+//
+// The new values of the changed counts are written to a journal first, which
+// once renamed into place is applied to the day files and then removed,
+// after the timestamp has been updated.  If the program stops part way
+// through, recover() applies the journal again.  So the day files always
+// end up holding exactly the articles before the high-water mark: nothing is
+// counted twice, or missed.
+//
+// The hour and day totals for each year are updated at the same time, from
+// the same counts.
+static void checkpoint() {
+  // Changes by tier, file, row and bucket
+  std::map<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>, map_entry>
+      changes;
+  auto change = [&](uint32_t tier, uint32_t file, uint32_t row,
+                    uint32_t bucket, const map_entry &delta) {
+    auto it = changes.find(std::make_tuple(tier, file, row, bucket));
+    if(it == changes.end())
+      it = changes
+               .emplace(std::make_tuple(tier, file, row, bucket),
+                        find_file(tier, file)->row(row)[bucket])
+               .first;
+    it->second.articles += delta.articles;
+    it->second.bytes += delta.bytes;
+  };
+  for(auto &r: row_index) {
+    const uint32_t number = r.first >> 32;
+    const int year = number / (12 * 32) + 1900;
+    const int yday = day_of_year(year, number / 32 % 12 + 1, number % 32);
+    for(auto &p: r.second.pending) {
+      change(TIER_MINUTES, number, r.second.row, p.first, p.second);
+      change(TIER_HOURS, year, r.second.hour_row, 24 * yday + p.first / 60,
+             p.second);
+      change(TIER_DAYS, year, r.second.day_row, yday, p.second);
+    }
+    r.second.pending.clear();
+  }
+  if(!changes.empty()) {
+    // The journal refers to peers by position, so new files and peers must
+    // be on disk first
+    for(int tier = 0; tier < TIERS; ++tier)
+      for(auto &f: open_files[tier])
+        f.second->sync();
+    sync_directory(state);
+    std::vector<char> buffer(sizeof(journal_header)
+                             + changes.size() * sizeof(journal_entry));
+    journal_header *h = (journal_header *)buffer.data();
+    memcpy(h->magic, JOURNAL_MAGIC, sizeof h->magic);
+    h->sec = latest_time.tv_sec;
+    h->usec = latest_time.tv_usec;
+    h->count = latest_count;
+    h->entries = changes.size();
+    std::vector<journal_entry> journal;
+    for(auto &c: changes)
+      journal.push_back({std::get<1>(c.first), std::get<2>(c.first),
+                         std::get<3>(c.first), std::get<0>(c.first),
+                         c.second});
+    memcpy(h + 1, journal.data(), journal.size() * sizeof(journal_entry));
+    replace_file("journal", buffer.data(), buffer.size());
+    apply_journal(journal);
+  }
+  write_timestamp();
+  if(!changes.empty() && unlink("journal") < 0)
+    fatal(errno, "removing journal");
+  // Close the earliest files if there are too many
+  for(int tier = 0; tier < TIERS; ++tier) {
+    while(open_files[tier].size() > FILE_CACHE) {
+      const state_file *earliest = open_files[tier].begin()->second.get();
+      // Rows in the year files are only positions, and stay valid
+      for(auto r = row_index.begin(); r != row_index.end();) {
+        if(r->second.file == earliest)
+          r = row_index.erase(r);
+        else
+          ++r;
+      }
+      open_files[tier].erase(open_files[tier].begin());
+    }
+  }
   time_counter = 0;
+  next_checkpoint = time(NULL) + checkpoint_interval;
+}
+
+// Render graphs for every day for which new data was gathered, and fix up
+// links & index
+//
+// The week, month and year graphs that include those days are drawn from the
+// hour and day totals.
+static void render() {
+  std::set<std::string> weeks, months, years;
+  for(const std::string &day: days_changed) {
+    int y, m, d;
+    if(sscanf(day.c_str(), "%d-%d-%d", &y, &m, &d) != 3)
+      continue;
+    // Weeks start on Monday
+    struct tm t;
+    memset(&t, 0, sizeof t);
+    t.tm_year = y - 1900;
+    t.tm_mon = m - 1;
+    t.tm_mday = d;
+    time_t monday = timegm(&t);
+    if(!gmtime_r(&monday, &t))
+      fatal(errno, "gmtime_r");
+    monday -= (t.tm_wday + 6) % 7 * 86400;
+    if(!gmtime_r(&monday, &t))
+      fatal(errno, "gmtime_r");
+    char name[32];
+    snprintf(name, sizeof name, "%04d-%02d-%02d", t.tm_year + 1900,
+             t.tm_mon + 1, t.tm_mday);
+    weeks.insert(name);
+    months.insert(day.substr(0, 7));
+    years.insert(day.substr(0, 4));
+  }
+  std::for_each(days_changed.begin(), days_changed.end(), process_day);
+  std::for_each(weeks.begin(), weeks.end(), process_week);
+  std::for_each(months.begin(), months.end(), process_month);
+  std::for_each(years.begin(), years.end(), process_year);
+  days_changed.clear();
+  fixup_html("-peers.html", true);
+  fixup_html("-week.html", false);
+  fixup_html("-month.html", false);
+  fixup_html("-year.html", false);
+}
+
+// Remove day files older than keep_minutes days, and hour totals for years
+// that ended longer ago than keep_hours days, counting back from the latest
+// article
+static void expire() {
+  if(!latest_time.tv_sec)
+    return;
+  auto cutoff = [](int days, char (&date)[32]) {
+    const time_t when = latest_time.tv_sec - (time_t)days * 86400;
+    struct tm t;
+    if(!localtime_r(&when, &t))
+      fatal(errno, "localtime_r");
+    snprintf(date, sizeof date, "%04d-%02d-%02d", t.tm_year + 1900,
+             t.tm_mon + 1, t.tm_mday);
+  };
+  std::vector<std::string> names;
+  if(keep_minutes) {
+    char date[32];
+    cutoff(keep_minutes, date);
+    list_directory(state, names, [&](const std::string &name) {
+      return ends_with(name, DAY_EXTENSION) && name.compare(0, 10, date) < 0;
+    });
+  }
+  if(keep_hours) {
+    char date[32];
+    cutoff(keep_hours, date);
+    list_directory(state, names, [&](const std::string &name) {
+      return ends_with(name, HOURS_EXTENSION)
+             && name.compare(0, 4, date, 4) < 0;
+    });
+  }
+  for(const std::string &name: names) {
+    const std::string path = state + "/" + name;
+    if(unlink(path.c_str()) < 0)
+      fatal(errno, "unlink %s", path.c_str());
+  }
 }
 
+// Called while waiting for more of a log that is being followed
+static void idle() {
+  const time_t now = time(NULL);
+  // Guess years from the current date, not when the program started
+  if(!localtime_r(&now, &start_time))
+    fatal(errno, "localtime_r");
+  if(time_counter && now >= next_checkpoint)
+    checkpoint();
+  if(now >= next_render) {
+    if(time_counter)
+      checkpoint();
+    if(!days_changed.empty()) {
+      // expire() may remove files that are open
+      close_days();
+      render();
+      expire();
+    }
+    next_render = now + render_interval;
+  }
+}
+
+// A graph of the counts for some period, in equal buckets
+struct graph {
+  std::string name;  // start of the image filenames
+  std::string title; // for the HTML page
+  std::string html;  // filename of the HTML page
+  std::string unit;  // length of a bucket, for the graph titles
+  size_t buckets;
+  std::vector<std::pair<double, std::string>> ticks; // position (0-1), label
+};
+
 static void process_day(const std::string &day) {
+  state_file f(state + "/" + day + DAY_EXTENSION, minute_format, false);
   std::map<std::string, map_entry *> info;
+  for(size_t n = 0; n < f.peers(); ++n)
+    info[f.name(n)] = f.row(n);
+  graph g{day, day, day + "-peers.html", "minute", MAP_BUCKETS, {}};
+  for(int h = 0; h < 24; ++h) {
+    char hour[32];
+    snprintf(hour, sizeof hour, "%02d", h);
+    g.ticks.push_back(std::make_pair(h / 24.0, hour));
+  }
+  draw_graph(g, info);
+}
+
+// Read COUNT buckets of each peer's counts from the TIER files, starting at
+// bucket FIRST of YEAR and carrying on into the next year if necessary.
+// Peers with no articles in that time are left out.
+static void read_series(int tier, int year, size_t first, size_t count,
+                        std::map<std::string, std::vector<map_entry>> &series) {
+  const size_t per_day = tier == TIER_HOURS ? 24 : 1;
+  for(size_t done = 0; done < count; ++year, first = 0) {
+    const size_t n =
+        std::min(count - done, per_day * days_in_year(year) - first);
+    state_file f(state + "/" + std::to_string(year) + tier_extensions[tier],
+                 *tier_formats[tier], false);
+    for(size_t p = 0; p < f.peers(); ++p) {
+      const map_entry *row = f.row(p) + first;
+      if(std::none_of(row, row + n,
+                      [](const map_entry &m) { return m.articles != 0; }))
+        continue;
+      std::vector<map_entry> &s = series[f.name(p)];
+      s.resize(count, map_entry{0, 0});
+      std::copy(row, row + n, s.begin() + done);
+    }
+    done += n;
+  }
+}
+
+// Draw a graph from the totals read by read_series()
+static void draw_series(const graph &g,
+                        std::map<std::string, std::vector<map_entry>> &series) {
+  std::map<std::string, map_entry *> info;
+  for(auto &s: series)
+    info[s.first] = s.second.data();
+  if(!info.empty())
+    draw_graph(g, info);
+}
+
+// WEEK is the date of its Monday
+static void process_week(const std::string &week) {
+  static const char *const days[] = {"Mon", "Tue", "Wed", "Thu",
+                                     "Fri", "Sat", "Sun"};
+  int y, m, d;
+  if(sscanf(week.c_str(), "%d-%d-%d", &y, &m, &d) != 3)
+    return;
+  graph g{week + "-week", "week of " + week, week + "-week.html", "hour",
+          24 * 7, {}};
+  for(int n = 0; n < 7; ++n)
+    g.ticks.push_back(std::make_pair(n / 7.0, days[n]));
+  std::map<std::string, std::vector<map_entry>> series;
+  read_series(TIER_HOURS, y, 24 * day_of_year(y, m, d), g.buckets, series);
+  draw_series(g, series);
+}
+
+// MONTH is YYYY-MM
+static void process_month(const std::string &month) {
+  int y, m;
+  if(sscanf(month.c_str(), "%d-%d", &y, &m) != 2)
+    return;
+  graph g{month + "-month", month, month + "-month.html", "day",
+          (size_t)days_in_month(y, m), {}};
+  for(size_t d = 0; d < g.buckets; ++d)
+    g.ticks.push_back(
+        std::make_pair((double)d / g.buckets, std::to_string(d + 1)));
+  std::map<std::string, std::vector<map_entry>> series;
+  read_series(TIER_DAYS, y, day_of_year(y, m, 1), g.buckets, series);
+  draw_series(g, series);
+}
+
+static void process_year(const std::string &year) {
+  static const char *const months[] = {"Jan", "Feb", "Mar", "Apr",
+                                       "May", "Jun", "Jul", "Aug",
+                                       "Sep", "Oct", "Nov", "Dec"};
+  const int y = atoi(year.c_str());
+  graph g{year + "-year", year, year + "-year.html", "day",
+          (size_t)days_in_year(y), {}};
+  for(int m = 1; m <= 12; ++m)
+    g.ticks.push_back(std::make_pair((double)day_of_year(y, m, 1) / g.buckets,
+                                     months[m - 1]));
+  std::map<std::string, std::vector<map_entry>> series;
+  read_series(TIER_DAYS, y, 0, g.buckets, series);
+  draw_series(g, series);
+}
+
+// Return the years for which there are day files but no day totals
+static std::set<std::string> missing_totals() {
+  std::vector<std::string> names;
+  list_directory(state, names, [](const std::string &name) {
+    return ends_with(name, DAY_EXTENSION) || ends_with(name, DAYS_EXTENSION);
+  });
+  std::set<std::string> years, totals;
+  for(const std::string &name: names)
+    if(ends_with(name, DAYS_EXTENSION))
+      totals.insert(name.substr(0, 4));
+    else
+      years.insert(name.substr(0, 4));
+  for(const std::string &year: totals)
+    years.erase(year);
+  return years;
+}
+
+// Build the hour and day totals for YEAR from its day files.  They are
+// written alongside and renamed into place, the day totals last, since
+// check_state() only looks for those.
+static void build_totals(const std::string &year) {
+  std::unique_ptr<state_file> totals[TIERS];
+  for(int tier = TIER_HOURS; tier < TIERS; ++tier) {
+    const std::string path = state + "/" + year + tier_extensions[tier];
+    // Discard anything left by an earlier attempt
+    if(unlink((path + ".build").c_str()) < 0 && errno != ENOENT)
+      fatal(errno, "unlink %s.build", path.c_str());
+    totals[tier].reset(
+        new state_file(path + ".build", *tier_formats[tier], true));
+  }
+  std::vector<std::string> names;
+  list_directory(state, names, [&](const std::string &name) {
+    return name.size() == 10 + strlen(DAY_EXTENSION)
+           && name.compare(0, 4, year) == 0 && ends_with(name, DAY_EXTENSION);
+  });
+  for(const std::string &name: names) {
+    int y, m, d;
+    if(sscanf(name.c_str(), "%d-%d-%d", &y, &m, &d) != 3)
+      continue;
+    const int yday = day_of_year(y, m, d);
+    state_file f(state + "/" + name, minute_format, false);
+    for(size_t p = 0; p < f.peers(); ++p) {
+      const map_entry *row = f.row(p);
+      const size_t hour_row = totals[TIER_HOURS]->find(f.name(p));
+      const size_t day_row = totals[TIER_DAYS]->find(f.name(p));
+      map_entry *hours = totals[TIER_HOURS]->row(hour_row);
+      map_entry *days = totals[TIER_DAYS]->row(day_row);
+      for(size_t i = 0; i < MAP_BUCKETS; ++i) {
+        hours[24 * yday + i / 60].articles += row[i].articles;
+        hours[24 * yday + i / 60].bytes += row[i].bytes;
+        days[yday].articles += row[i].articles;
+        days[yday].bytes += row[i].bytes;
+      }
+    }
+  }
+  for(int tier = TIER_HOURS; tier < TIERS; ++tier) {
+    totals[tier]->sync();
+    const std::string path = state + "/" + year + tier_extensions[tier];
+    if(rename(totals[tier]->path.c_str(), path.c_str()) < 0)
+      fatal(errno, "rename %s", totals[tier]->path.c_str());
+    sync_directory(state);
+  }
+}
+
+// Convert old state files, one per peer per day, into day files, and add the
+// hour and day totals for years that have none.
+//
+// Each old file becomes exactly one row of its day file, so the row is set
+// rather than added to, and the old files for a day are only removed once
+// the day file is on disk.  So if the conversion is interrupted it can just
+// be run again.
+static void migrate() {
   std::vector<std::string> names;
-  list_directory(state, names);
-  std::for_each(names.begin(), names.end(), [&](std::string &name) {
-    if(starts_with(name, day) && name[day.size()] == '-'
-       && ends_with(name, MAP_EXTENSION)) {
-      std::string path = state + "/" + name;
-      std::string peer(name, day.size() + 1,
-                       name.size() - (1 + day.size() + strlen(MAP_EXTENSION)));
-      info[peer] = open_map(path);
+  list_directory(state, names, [](const std::string &name) {
+    return name.size() > 11 + strlen(MAP_EXTENSION) && name[10] == '-'
+           && ends_with(name, MAP_EXTENSION);
+  });
+  std::sort(names.begin(), names.end());
+  for(size_t first = 0, last; first < names.size(); first = last) {
+    const std::string day = names[first].substr(0, 10);
+    for(last = first;
+        last < names.size() && names[last].compare(0, 10, day) == 0; ++last)
+      ;
+    state_file f(state + "/" + day + DAY_EXTENSION, minute_format, true);
+    for(size_t n = first; n < last; ++n) {
+      const std::string &name = names[n];
+      map_entry *map = open_map(state + "/" + name);
+      map_entry *row = f.row(
+          f.find(name.substr(11, name.size() - (11 + strlen(MAP_EXTENSION)))));
+      for(size_t i = 0; i < MAP_BUCKETS; ++i)
+        row[i] = map[i];
+      close_map(map);
     }
+    f.sync();
+    for(size_t n = first; n < last; ++n) {
+      const std::string old = state + "/" + names[n];
+      if(unlink(old.c_str()) < 0)
+        fatal(errno, "unlink %s", old.c_str());
+    }
+  }
+  // The totals must include any checkpoint that was interrupted
+  recover();
+  for(const std::string &year: missing_totals())
+    build_totals(year);
+}
+
+// Refuse to run with unconverted state files, which would be ignored, or
+// without the totals for a year
+static void check_state() {
+  std::vector<std::string> names;
+  list_directory(state, names, [](const std::string &name) {
+    return ends_with(name, MAP_EXTENSION);
   });
-  draw_graph(day, info);
-  std::for_each(info.begin(), info.end(),
-                [](const std::pair<std::string, map_entry *> &m) {
-                  close_map(m.second);
-                });
+  if(!names.empty() || !missing_totals().empty())
+    fatal(0, "%s contains old state files; use news-sources --migrate",
+          state.c_str());
 }
 
 static double round_scale(double n, double &base) {
@@ -499,26 +1503,28 @@ static Cairo::ErrorStatus cairo_writer(const unsigned char *data, unsigned len,
 }
 
 template <typename GET_DATA>
-void draw_one_graph(const std::string &day,
+void draw_one_graph(const graph &g,
                     const std::map<std::string, map_entry *> &info,
                     const std::string &type, const std::string &title,
                     GET_DATA get_data) {
-  double range[MAP_BUCKETS];
-  memset(range, 0, sizeof range);
-  for(int n = 0; n < MAP_BUCKETS; ++n) {
+  std::vector<double> range(g.buckets);
+  for(size_t n = 0; n < g.buckets; ++n) {
     std::for_each(info.begin(), info.end(),
                   [&](const std::pair<std::string, map_entry *> &m) {
                     range[n] += get_data(m.second[n]);
                   });
   }
-  std::sort(&range[0], &range[MAP_BUCKETS]);
+  std::sort(range.begin(), range.end());
   // Find the maximum size; the top trim% is excluded to avoid spikes dominating
-  // the graph too much.
+  // the graph too much.  If that leaves nothing, then use the whole range.
   double base, max;
-  max = round_scale(range[(int)floor(MAP_BUCKETS * (100 - trim) / 100)], base);
+  size_t top = floor(g.buckets * (100 - trim) / 100);
+  if(top >= g.buckets || !range[top])
+    top = g.buckets - 1;
+  max = round_scale(range[top] ? range[top] : 1, base);
   Cairo::RefPtr<Cairo::Surface> surface;
   if(svg) {
-    const std::string path = output + "/" + day + "-" + type + ".svg";
+    const std::string path = output + "/" + g.name + "-" + type + ".svg";
     FILE *file = fopen(path.c_str(), "w");
     if(!file)
       fatal(errno, "opening %s", path.c_str());
@@ -534,7 +1540,7 @@ void draw_one_graph(const std::string &day,
   context->set_source_rgb(1.0, 1.0, 1.0);
   context->paint();
   // Draw the data
-  for(int n = 0; n < MAP_BUCKETS; ++n) {
+  for(size_t n = 0; n < g.buckets; ++n) {
     uint64_t data_below = 0;
     int npeer = 0;
     std::for_each(info.begin(), info.end(),
@@ -545,8 +1551,8 @@ void draw_one_graph(const std::string &day,
                           colors[npeer][0], colors[npeer][1], colors[npeer][2]);
                       double y0 = data_below * height / max;
                       double y1 = (data_below + data) * height / max;
-                      double x0 = n * width / MAP_BUCKETS;
-                      double x1 = (n + 1) * width / MAP_BUCKETS;
+                      double x0 = n * width / g.buckets;
+                      double x1 = (n + 1) * width / g.buckets;
                       context->rectangle(margin + x0, margin + height - y1,
                                          x1 - x0, y1 - y0);
                       context->fill();
@@ -556,39 +1562,40 @@ void draw_one_graph(const std::string &day,
                   });
   }
   // Axes
-  draw_axes(context, max, base, title);
+  draw_axes(context, g, max, base, title);
   if(!svg) {
     // Save to PNG
-    surface->write_to_png(output + "/" + day + "-" + type + ".png");
+    surface->write_to_png(output + "/" + g.name + "-" + type + ".png");
   }
   surface->finish();
 }
 
-static void draw_graph(const std::string &day,
+static void draw_graph(const graph &g,
                        const std::map<std::string, map_entry *> &info) {
-  draw_one_graph(day, info, "articles", "Articles/minute",
+  draw_one_graph(g, info, "articles", "Articles/" + g.unit,
                  [](const map_entry &m) { return m.articles; });
-  draw_one_graph(day, info, "bytes", "Bytes/minute",
+  draw_one_graph(g, info, "bytes", "Bytes/" + g.unit,
                  [](const map_entry &m) { return m.bytes; });
   // Generate an HTML wrapper
-  const std::string &html = output + "/" + day + "-peers.html";
+  const std::string &html = output + "/" + g.html;
+  const char *const day = g.name.c_str(), *const title = g.title.c_str();
   FILE *fp;
   if(!(fp = fopen(html.c_str(), "w")))
     fatal(errno, "creating %s", html.c_str());
-  fprintf(fp, "<head><title>Peering data for %s</title>\n", day.c_str());
+  fprintf(fp, "<head><title>Peering data for %s</title>\n", title);
   fprintf(fp, "<style type=\"text/css\">\n");
   fprintf(fp, ".blob {float:left;margin-right:1em;height:20px;width:32px;}\n");
   fprintf(fp, "img { border: 1px solid black; }\n");
   fprintf(fp, "</style>\n");
-  fprintf(fp, "<body><h1>Peering data for %s</h1>\n", day.c_str());
+  fprintf(fp, "<body><h1>Peering data for %s</h1>\n", title);
   if(svg) {
     fprintf(fp, "<p><img src=\"%s-articles.svg\" width=%g height=%g></p>\n",
-            day.c_str(), width + 2 * margin, height + 2 * margin);
+            day, width + 2 * margin, height + 2 * margin);
     fprintf(fp, "<p><img src=\"%s-bytes.svg\" width=%g height=%g></p>\n",
-            day.c_str(), width + 2 * margin, height + 2 * margin);
+            day, width + 2 * margin, height + 2 * margin);
   } else {
-    fprintf(fp, "<p><img src=\"%s-articles.png\"></p>\n", day.c_str());
-    fprintf(fp, "<p><img src=\"%s-bytes.png\"></p>\n", day.c_str());
+    fprintf(fp, "<p><img src=\"%s-articles.png\"></p>\n", day);
+    fprintf(fp, "<p><img src=\"%s-bytes.png\"></p>\n", day);
   }
   int npeer = info.size();
   std::for_each(info.rbegin(), info.rend(),
@@ -609,8 +1616,8 @@ static void draw_graph(const std::string &day,
     fatal(errno, "writing %s", html.c_str());
 }
 
-static void draw_axes(Cairo::RefPtr<Cairo::Context> context, double max,
-                      double base, const std::string &title) {
+static void draw_axes(Cairo::RefPtr<Cairo::Context> context, const graph &g,
+                      double max, double base, const std::string &title) {
   Cairo::TextExtents te;
   Cairo::FontExtents fe;
 
@@ -623,15 +1630,13 @@ static void draw_axes(Cairo::RefPtr<Cairo::Context> context, double max,
   context->set_source_rgb(0.0, 0.0, 0.0);
   context->rectangle(margin, margin + height, width, 1);
   context->fill();
-  for(int h = 0; h < 24; ++h) {
-    char hour[32];
-    snprintf(hour, sizeof hour, "%02d", h);
-    double x = margin + h * width / 24;
+  for(const auto &tick: g.ticks) {
+    double x = margin + tick.first * width;
     double y = margin + height + 1;
     context->rectangle(x, y, 1, 1);
     context->fill();
     context->move_to(x + 1, y + 1 + fe.height);
-    context->show_text(hour);
+    context->show_text(tick.second);
   }
 
   // Quantity
@@ -659,10 +1664,12 @@ static void draw_axes(Cairo::RefPtr<Cairo::Context> context, double max,
   context->show_text(title);
 }
 
-static void fixup_html() {
+// Link each HTML page ending SUFFIX to the ones before and after it, and if
+// INDEX is true point the index at the latest
+static void fixup_html(const std::string &suffix, bool index) {
   std::vector<std::string> names;
-  list_directory(output, names, [](const std::string &name) {
-    return ends_with(name, "-peers.html");
+  list_directory(output, names, [&](const std::string &name) {
+    return ends_with(name, suffix);
   });
   std::sort(names.begin(), names.end());
   for(size_t n = 0; n < names.size(); ++n) {
@@ -692,7 +1699,7 @@ static void fixup_html() {
     if(changes)
       write_file(path, lines);
   }
-  if(!names.empty() && index_path.size()) {
+  if(index && !names.empty() && index_path.size()) {
     const char *target;
     std::string index_abs =
         index_path.at(0) == '/' ? index_path : output + "/" + index_path;
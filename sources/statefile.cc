@@ -0,0 +1,202 @@
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include <config.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "statefile.h"
+
+const state_format minute_format = {"nsday01\n", MAP_BUCKETS};
+const state_format hour_format = {"nshrs01\n", 24 * YEAR_DAYS};
+const state_format day_format = {"nsdys01\n", YEAR_DAYS};
+
+struct state_header {
+  char magic[8];     // from the state_format
+  uint32_t peers;    // number of peers
+  uint32_t capacity; // number of peers there is room for
+};
+
+// Layout of a state file with room for CAPACITY peers
+static size_t names_offset() {
+  return sizeof(state_header);
+}
+
+size_t state_file::rows_offset(size_t capacity) const {
+  return names_offset() + capacity * PEER_NAME_MAX;
+}
+
+size_t state_file::file_size(size_t capacity) const {
+  return rows_offset(capacity) + capacity * format.buckets * sizeof(map_entry);
+}
+
+// Copy LEN bytes from SRC to DST, a new sparse file, leaving out pages that
+// are all 0 so that they don't take up space
+static void copy_sparse(char *dst, const char *src, size_t len) {
+  static const char zero[4096] = {0};
+  while(len > 0) {
+    const size_t n = std::min(len, sizeof zero);
+    if(memcmp(src, zero, n))
+      memcpy(dst, src, n);
+    dst += n;
+    src += n;
+    len -= n;
+  }
+}
+
+// Wait until the entries in the directory containing PATH are on disk
+static void sync_parent(const std::string &path) {
+  const size_t slash = path.rfind('/');
+  const std::string dir =
+      slash == std::string::npos ? "." : path.substr(0, slash);
+  int fd;
+  if((fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY)) < 0)
+    fatal(errno, "open %s", dir.c_str());
+  if(fsync(fd) < 0)
+    fatal(errno, "fsync %s", dir.c_str());
+  if(close(fd) < 0)
+    fatal(errno, "close %s", dir.c_str());
+}
+
+state_file::state_file(const std::string &path_, const state_format &format_,
+                       bool writable_):
+    path(path_), format(format_), writable(writable_) {
+  int fd;
+  if((fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY)) < 0) {
+    if(errno != ENOENT)
+      fatal(errno, "open %s", path.c_str());
+    if(writable)
+      create(STATE_CAPACITY);
+    return;
+  }
+  struct stat sb;
+  if(fstat(fd, &sb) < 0)
+    fatal(errno, "stat %s", path.c_str());
+  size = sb.st_size;
+  if(size < sizeof(state_header))
+    fatal(0, "%s: truncated", path.c_str());
+  base = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+              MAP_SHARED, fd, 0);
+  if(base == MAP_FAILED)
+    fatal(errno, "mmap %s", path.c_str());
+  if(close(fd) < 0)
+    fatal(errno, "close %s", path.c_str());
+  header = (state_header *)base;
+  if(memcmp(header->magic, format.magic, sizeof header->magic))
+    fatal(0, "%s: not the expected kind of state file", path.c_str());
+  if(size != file_size(header->capacity) || header->peers > header->capacity)
+    fatal(0, "%s: corrupt", path.c_str());
+}
+
+state_file::~state_file() {
+  unmap();
+}
+
+size_t state_file::peers() const {
+  return header ? header->peers : 0;
+}
+
+const char *state_file::name(size_t n) const {
+  return (const char *)base + names_offset() + n * PEER_NAME_MAX;
+}
+
+map_entry *state_file::row(size_t n) const {
+  return (map_entry *)((char *)base + rows_offset(header->capacity))
+         + n * format.buckets;
+}
+
+size_t state_file::find(const std::string &peer) {
+  size_t n;
+  for(n = 0; n < header->peers; ++n)
+    if(peer == name(n))
+      return n;
+  if(n == header->capacity)
+    create(2 * header->capacity);
+  memcpy((char *)name(n), peer.data(), peer.size());
+  ++header->peers;
+  return n;
+}
+
+void state_file::sync() {
+  if(base && msync(base, size, MS_SYNC) < 0)
+    fatal(errno, "msync %s", path.c_str());
+}
+
+// Replace the file with one with room for CAPACITY peers, containing the
+// peers from the current one if there is one.  The new file is built
+// alongside, written to disk and then renamed into place, so the file is
+// always complete, even after a crash.
+void state_file::create(uint32_t capacity) {
+  const std::string tmp = path + ".new";
+  const size_t new_size = file_size(capacity);
+  int fd;
+  if((fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+    fatal(errno, "open %s", tmp.c_str());
+  if(ftruncate(fd, new_size) < 0)
+    fatal(errno, "ftruncate %s", tmp.c_str());
+  void *new_base =
+      mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(new_base == MAP_FAILED)
+    fatal(errno, "mmap %s", tmp.c_str());
+  if(close(fd) < 0)
+    fatal(errno, "close %s", tmp.c_str());
+  state_header *new_header = (state_header *)new_base;
+  memcpy(new_header->magic, format.magic, sizeof new_header->magic);
+  new_header->capacity = capacity;
+  if(header) {
+    new_header->peers = header->peers;
+    memcpy((char *)new_base + names_offset(), name(0),
+           header->peers * PEER_NAME_MAX);
+    copy_sparse((char *)new_base + rows_offset(capacity), (char *)row(0),
+                header->peers * format.buckets * sizeof(map_entry));
+  }
+  if(msync(new_base, new_size, MS_SYNC) < 0)
+    fatal(errno, "msync %s", tmp.c_str());
+  if(rename(tmp.c_str(), path.c_str()) < 0)
+    fatal(errno, "rename %s", tmp.c_str());
+  sync_parent(path);
+  unmap();
+  base = new_base;
+  size = new_size;
+  header = new_header;
+}
+
+void state_file::unmap() {
+  if(base && munmap(base, size) < 0)
+    fatal(errno, "munmap %s", path.c_str());
+  base = NULL;
+  header = NULL;
+}
+
+std::string peer_name(std::string_view peer) {
+  std::string name(peer.substr(0, PEER_NAME_MAX - 1));
+  for(size_t pos = 0; pos < name.size(); ++pos) {
+    if(!(name[pos] > ' ' && name[pos] < 0x7F))
+      name[pos] = 'X';
+  }
+  return name;
+}
@@ -0,0 +1,112 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Counts for one minute, hour or day
+struct map_entry {
+  uint64_t articles;
+  uint64_t bytes;
+};
+
+// Minutes in a day
+#define MAP_BUCKETS (60 * 24)
+
+// Longest year, in days
+#define YEAR_DAYS 366
+
+#define DAY_EXTENSION ".nsday"
+#define HOURS_EXTENSION ".nshours"
+#define DAYS_EXTENSION ".nsdays"
+
+// Space for a peer name, including the terminating 0
+#define PEER_NAME_MAX 256
+
+// Peers a new state file has room for
+#define STATE_CAPACITY 64
+
+// A kind of state file
+struct state_format {
+  char magic[9];  // 8 bytes and a 0
+  size_t buckets; // counts for each peer
+};
+
+extern const state_format minute_format; // a day, by minute
+extern const state_format hour_format;   // a year, by hour of the year
+extern const state_format day_format;    // a year, by day of the year
+
+struct state_header;
+
+// A state file.  It holds a header, a table of peer names and then a row of
+// counts for each peer, so that the whole file can be read with a single
+// mapping.  Room is left for more peers than are present; when it runs out
+// the file is replaced with a larger one.
+class state_file {
+public:
+  // Map the state file at PATH.  If WRITABLE is true it is created if it does
+  // not exist; otherwise a missing file is treated as having no peers.
+  state_file(const std::string &path, const state_format &format,
+             bool writable);
+  state_file(const state_file &) = delete;
+  state_file &operator=(const state_file &) = delete;
+  ~state_file();
+
+  const std::string path;
+  const state_format &format;
+
+  // Return the number of peers
+  size_t peers() const;
+
+  // Return the name of peer N
+  const char *name(size_t n) const;
+
+  // Return the counts for peer N.  The pointer is invalidated by find().
+  map_entry *row(size_t n) const;
+
+  // Return the index of PEER (as returned by peer_name()), adding it if
+  // necessary.  Indexes do not change when peers are added.
+  size_t find(const std::string &peer);
+
+  // Wait until the file on disk matches the mapping
+  void sync();
+
+private:
+  bool writable;
+  void *base = NULL;
+  size_t size = 0;
+  state_header *header = NULL;
+
+  size_t rows_offset(size_t capacity) const;
+  size_t file_size(size_t capacity) const;
+  void create(uint32_t capacity);
+  void unmap();
+};
+
+// Return PEER in the form used for state files: unprintable characters are
+// replaced with X and it is truncated to fit PEER_NAME_MAX
+std::string peer_name(std::string_view peer);
+
+#endif /* STATEFILE_H */
@@ -0,0 +1,51 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <algorithm>
+
+using namespace std;
+
+void read_active(const string &path, vector<ActiveGroup> &groups) {
+  vector<string> lines, bits;
+  read_file(path, lines);
+  for(size_t n = 0; n < lines.size(); ++n) {
+    string &line = lines[n];
+    if(line.size() && line[line.size() - 1] == '\n')
+      line.erase(line.size() - 1);
+    bits.clear();
+    split(bits, ' ', line);
+    if(bits.size() < 3)
+      fatal(0, "%s:%zu: malformed line", path.c_str(), n + 1);
+    if(Config::hierarchies.find(bits[0].substr(0, bits[0].find('.')))
+       == Config::hierarchies.end())
+      continue;
+    ActiveGroup g;
+    g.name = bits[0];
+    g.high = atol(bits[1].c_str());
+    g.low = atol(bits[2].c_str());
+    groups.push_back(g);
+  }
+}
+
+string group_dir(const string &name) {
+  string dir = Config::spool + "/" + name;
+  replace(dir.begin() + Config::spool.size() + 1, dir.end(), '.', '/');
+  return dir;
+}
@@ -0,0 +1,37 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef ACTIVE_H
+#define ACTIVE_H
+
+// One line from INN's active file
+struct ActiveGroup {
+  std::string name;
+  long high; // highest article number
+  long low;  // lowest article number (high+1 if empty)
+};
+
+// Read the groups in wanted hierarchies from the active file at PATH
+void read_active(const std::string &path, std::vector<ActiveGroup> &groups);
+
+// Return the directory for group NAME within the spool
+std::string group_dir(const std::string &name);
+
+#endif /* ACTIVE_H */
@@ -24,10 +24,35 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 
 using namespace std;
 
-AllGroups::~AllGroups() {}
+// Directories with at least this many entries are read with several threads
+// (if --jobs allows)
+static const size_t large_directory = 4096;
+
+AllGroups::AllGroups(time_t start, bool fresh):
+    window_start(start), current(NULL), records(NULL), next_checkpoint(0),
+    segment(NULL), segment_records(0), committed(), files(0), included(0),
+    skip_lwm(0), skip_mtime(0), dirs(0) {
+  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
+      it != Config::hierarchies.end(); ++it)
+    hierarchies[it->first] = fresh ? new Hierarchy(it->first) : it->second;
+  for(size_t n = 0; n < Config::analyses.size(); ++n)
+    analyzers.push_back(Analyzer::find(Config::analyses[n]));
+  if(Config::max_memory || Config::emit_partial.size()
+     || Config::partials.size() || Config::checkpoint.size())
+    records = new ExternalSorter<ArticleRecord>(Config::spill_dir,
+                                                Config::max_memory / 2);
+}
+
+AllGroups::~AllGroups() {
+  delete segment;
+  delete records;
+  for(size_t n = 0; n < analyzers.size(); ++n)
+    delete analyzers[n];
+}
 
 // Visit one article
 void AllGroups::visit(const Article *a) {
@@ -38,57 +63,169 @@ void AllGroups::visit(const Article *a) {
 
 // Scan the spool
 void AllGroups::scan() {
-  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
-      it != Config::hierarchies.end(); ++it) {
+  vector<ActiveGroup> active;
+  if(Config::active.size())
+    read_active(Config::active, active);
+  if(Config::checkpoint.size()) {
+    if(Config::resume && resume()) {
+      if(Config::terminal)
+        cerr << "resuming from " << Config::checkpoint << "\n";
+    } else
+      remove_checkpoint(); // any leftovers from an earlier scan
+    start_segment();
+    next_checkpoint = time(NULL) + Config::checkpoint_interval;
+  }
+  for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+      it != hierarchies.end(); ++it) {
     Hierarchy *const h = it->second;
-    recurse(Config::spool + "/" + h->name);
-    // TODO we could report and delete h here if we introduced an end_mtime.
+    if(Config::stream)
+      current = h;
+    if(Config::active.size()) {
+      for(size_t n = 0; n < active.size(); ++n)
+        if(active[n].name.compare(0, h->name.size(), h->name) == 0
+           && (active[n].name.size() == h->name.size()
+               || active[n].name[h->name.size()] == '.'))
+          scan_group(active[n]);
+    } else
+      recurse(Config::spool + "/" + h->name);
+    if(Config::stream) {
+      // Every article in h has now been seen, so it can be reported on and
+      // its per-sender data discarded, while the next hierarchy is scanned.
+      current_seen.clear();
+      if(reporter.joinable())
+        reporter.join();
+      reporter = thread(&Hierarchy::finish, h);
+    }
+  }
+  if(reporter.joinable())
+    reporter.join();
+  current = NULL;
+  // If interrupted from here on, a --resume need only load the records.
+  // The checkpoint is kept until the results have been written (see
+  // forget_checkpoint()).
+  if(Config::checkpoint.size())
+    checkpoint();
+  if(records && Config::emit_partial.empty())
+    replay();
+  if(Config::sample) {
+    estimate();
+    for(size_t n = 0; n < windows.size(); ++n)
+      windows[n]->estimate();
   }
   // AllGroups::recurse() keeps a running count, erase it now we're done
   if(Config::terminal)
     cerr << "                                                                  "
             "      \r";
+  // Rate-limited scans are usually run from cron, without a terminal, so
+  // this is reported regardless
+  if(!Config::quiet
+     && (Config::background || Config::files_per_second
+         || Config::bytes_per_second))
+    cerr << "rate limits delayed the scan by " << fixed << setprecision(1)
+         << throttled() << "s" << endl;
+}
+
+// Scale up everything from a --sample scan
+void AllGroups::estimate() {
+  Bucket::estimate(Config::sample);
+  for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+      it != hierarchies.end(); ++it) {
+    Hierarchy *const h = it->second;
+    h->estimate(Config::sample);
+    for(map<string, Group *>::const_iterator jt = h->groups.begin();
+        jt != h->groups.end(); ++jt)
+      jt->second->estimate(Config::sample);
+  }
+  useragents.estimate(Config::sample);
+  charsets.estimate(Config::sample);
+}
+
+// Report progress on the terminal
+void AllGroups::progress() {
+  cerr << included << "/" << files << " skip-lwm: " << skip_lwm
+       << " skip-mtime: " << skip_mtime << " dirs: " << dirs << "\r";
 }
 
 // Recurse into one directory
 void AllGroups::recurse(const string &dir) {
-  static int count, included;
-  DIR *dp;
-  struct dirent *de;
   string nodepath;
   struct stat sb;
   long low_water_mark = -1;
+  const bool mine = Config::in_shard(dir);
+  vector<DirectoryEntry> entries;
+  int fd;
 
+  if(done.count(dir)) // already scanned before a --resume
+    return;
+  starting();
   ++dirs;
-  if(!(dp = opendir(dir.c_str())))
+  if((fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY)) < 0)
     fatal(errno, "opening %s", dir.c_str());
-  errno = 0;
-  while((de = readdir(dp))) {
-    if(de->d_name[0] != '.') {
-      if(Config::terminal && count % 31 == 0)
-        cerr << included << "/" << count << " skip-lwm: " << skip_lwm
-             << " skip-mtime: " << skip_mtime << " dirs: " << dirs << "\r";
+  read_directory(fd, dir, entries);
+  if(Config::jobs > 1 && entries.size() >= large_directory) {
+    large(fd, dir, entries, mine);
+    close(fd);
+    finished(dir, true);
+    return;
+  }
+  // Only the articles that may be read are scheduled, so that (for instance)
+  // --read-order=physical doesn't look up files that won't be.  Everything
+  // else keeps its place in directory order.  The low-water mark depends on
+  // what has been read so far, so can't be applied yet.
+  vector<const DirectoryEntry *> order, readable;
+  vector<size_t> slots;
+  for(size_t n = 0; n < entries.size(); ++n) {
+    const DirectoryEntry &e = entries[n];
+    order.push_back(&e);
+    char *end;
+    errno = 0;
+    strtol(e.name.c_str(), &end, 10);
+    // The inode of a symlink isn't the article's, so whether it is in the
+    // sample is only known once it has been stat'd
+    if(e.name[0] != '.' && !errno && end != e.name.c_str() && !*end
+       && e.type != DT_DIR && mine
+       && (e.type == DT_LNK || e.type == DT_UNKNOWN
+           || Config::sampled(e.ino))) {
+      slots.push_back(n);
+      readable.push_back(&e);
+    }
+  }
+  schedule(fd, readable);
+  for(size_t n = 0; n < slots.size(); ++n)
+    order[slots[n]] = readable[n];
+  close(fd);
+  for(size_t n = 0; n < order.size(); ++n) {
+    const DirectoryEntry &e = *order[n];
+    if(e.name[0] != '.') {
+      if(Config::terminal && files % 31 == 0)
+        progress();
       // Convert filename to article number
       errno = 0;
       char *end;
-      long article = strtol(de->d_name, &end, 10);
-      if(errno || end == de->d_name || *end)
+      long article = strtol(e.name.c_str(), &end, 10);
+      if(errno || end == e.name.c_str() || *end)
         article = -1;
       else if(article < low_water_mark) {
-        ++count;
+        ++files;
         ++skip_lwm;
         continue;
       }
+      // Articles in other shards, or not in the sample, needn't even be
+      // stat'd
+      if((!mine || !Config::sampled(e.ino)) && e.type == DT_REG) {
+        ++files;
+        continue;
+      }
       nodepath = dir;
       nodepath += "/";
-      nodepath += de->d_name;
+      nodepath += e.name;
       if(stat(nodepath.c_str(), &sb) < 0)
         fatal(errno, "stat %s", nodepath.c_str());
       if(S_ISDIR(sb.st_mode))
         recurse(nodepath);
       else if(S_ISREG(sb.st_mode)) {
         // Skip articles that precede articles known to be too early by mtime
-        if(article >= 0) {
+        if(article >= 0 && mine && Config::sampled(sb.st_ino)) {
           if(sb.st_mtime >= Config::start_mtime)
             included += visit(nodepath);
           else {
@@ -96,73 +233,285 @@ void AllGroups::recurse(const string &dir) {
             ++skip_mtime;
           }
         }
-        count += 1;
+        files += 1;
       }
     }
-    errno = 0; // stupid readdir() API
   }
-  if(errno)
-    fatal(errno, "reading %s", dir.c_str());
-  closedir(dp);
+  finished(dir, true);
 }
 
-// Visit one article by name
-int AllGroups::visit(const string &path) {
-  int fd, bytes_read;
-  string article;
+// Scan a very large directory.  Instead of stat'ing each article in turn,
+// the articles are sorted and the ones to read found by binary search;
+// then they are read by several threads (see visit_articles()).
+void AllGroups::large(int fd, const string &dir,
+                      vector<DirectoryEntry> &entries, bool mine) {
+  vector<pair<long, const DirectoryEntry *>> names;
+  vector<string> subdirs;
+  struct stat sb;
+
+  for(size_t n = 0; n < entries.size(); ++n) {
+    DirectoryEntry &e = entries[n];
+    if(e.name[0] == '.')
+      continue;
+    unsigned char type = e.type;
+    if(type == DT_UNKNOWN || type == DT_LNK) {
+      // Filesystem doesn't report types, or a symlink (e.g. a crosspost),
+      // which like recurse() we classify by what it points to.  It is
+      // sampled by that too, like a hard link.
+      if(fstatat(fd, e.name.c_str(), &sb, 0) < 0)
+        fatal(errno, "stat %s/%s", dir.c_str(), e.name.c_str());
+      type = S_ISDIR(sb.st_mode) ? DT_DIR : S_ISREG(sb.st_mode) ? DT_REG : 0;
+      e.ino = sb.st_ino;
+    }
+    if(type == DT_DIR) {
+      subdirs.push_back(dir + "/" + e.name);
+      continue;
+    }
+    if(type != DT_REG)
+      continue;
+    ++files;
+    char *end;
+    errno = 0;
+    const long article = strtol(e.name.c_str(), &end, 10);
+    if(mine && !errno && end != e.name.c_str() && !*end)
+      names.push_back(make_pair(article, &e));
+  }
+  visit_articles(fd, dir, names);
+  for(size_t n = 0; n < subdirs.size(); ++n)
+    recurse(subdirs[n]);
+}
+
+// Scan one group's directory, as listed in the active file.  Unlike
+// recurse(), subdirectories are left alone (they are other groups, and
+// have their own active lines).
+void AllGroups::scan_group(const ActiveGroup &g) {
+  const string dir = group_dir(g.name);
+  vector<DirectoryEntry> entries;
+  vector<pair<long, const DirectoryEntry *>> names;
+  struct stat sb;
+  int fd;
+
+  if(!Config::in_shard(dir) || done.count(dir))
+    return;
+  starting();
+  ++dirs;
+  if((fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY)) < 0) {
+    if(errno == ENOENT) { // group has no directory
+      finished(dir, false);
+      return;
+    }
+    fatal(errno, "opening %s", dir.c_str());
+  }
+  read_directory(fd, dir, entries);
+  for(size_t n = 0; n < entries.size(); ++n) {
+    DirectoryEntry &e = entries[n];
+    char *end;
+    errno = 0;
+    const long article = strtol(e.name.c_str(), &end, 10);
+    if(e.name[0] == '.' || errno || end == e.name.c_str() || *end)
+      continue;
+    ++files;
+    // Articles below the low mark have expired
+    if(article < g.low) {
+      ++skip_lwm;
+      continue;
+    }
+    if(e.type == DT_UNKNOWN || e.type == DT_LNK) {
+      // Filesystem doesn't report types, or a symlink (e.g. a crosspost),
+      // which like recurse() we classify and sample by what it points to
+      if(fstatat(fd, e.name.c_str(), &sb, 0) < 0)
+        fatal(errno, "stat %s/%s", dir.c_str(), e.name.c_str());
+      e.ino = sb.st_ino;
+      if(S_ISREG(sb.st_mode))
+        names.push_back(make_pair(article, &e));
+    } else if(e.type == DT_REG)
+      names.push_back(make_pair(article, &e));
+  }
+  visit_articles(fd, dir, names);
+  close(fd);
+  if(Config::terminal)
+    progress();
+  finished(dir, false);
+}
+
+// Visit the articles NAMES (number, entry) in directory DIR (open on FD).
+// Instead of stat'ing every article the first one recent enough to be wanted
+// is found by binary search.  This assumes that mtime increases with article
+// number, which is nearly enough true; load() checks the Date: header anyway.
+// The remainder are read in the order chosen by --read-order.
+//
+// With --jobs the articles are read and parsed by several threads, a batch
+// at a time, and then credited in order by this one.  Reading and parsing
+// is where the time goes; crediting is cheap, and doing it serially keeps
+// the results identical to a single-threaded scan.
+void AllGroups::visit_articles(
+    int fd, const string &dir,
+    vector<pair<long, const DirectoryEntry *>> &names) {
+  struct stat sb;
+  sort(names.begin(), names.end());
+  // Find the first article modified inside the sampling interval.  An
+  // article that has vanished since the directory was read was expired, so
+  // must have been old.
+  size_t low = 0, high = names.size();
+  while(low < high) {
+    const size_t mid = low + (high - low) / 2;
+    bool recent = false;
+    if(fstatat(fd, names[mid].second->name.c_str(), &sb, 0) == 0)
+      recent = sb.st_mtime >= Config::start_mtime;
+    else if(errno != ENOENT)
+      fatal(errno, "stat %s/%s", dir.c_str(), names[mid].second->name.c_str());
+    if(recent)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  skip_mtime += low;
+  vector<const DirectoryEntry *> todo;
+  for(size_t n = low; n < names.size(); ++n)
+    if(Config::sampled(names[n].second->ino))
+      todo.push_back(names[n].second);
+  schedule(fd, todo);
+  if(Config::jobs <= 1) {
+    for(size_t n = 0; n < todo.size(); ++n)
+      included += visit(dir + "/" + todo[n]->name);
+    return;
+  }
+  const size_t batch = 256 * Config::jobs;
+  vector<Article> loaded(batch);
+  vector<char> ok(batch);
+  vector<vector<char>> buffers(Config::jobs);
+  for(size_t base = 0; base < todo.size(); base += batch) {
+    const size_t count = min(batch, todo.size() - base);
+    atomic<size_t> next(0);
+    auto work = [&](vector<char> *b) {
+      size_t i;
+      while((i = next++) < count)
+        ok[i] = load(dir + "/" + todo[base + i]->name, *b, loaded[i]);
+    };
+    vector<thread> workers;
+    for(unsigned j = 1; j < Config::jobs; ++j)
+      workers.push_back(thread(work, &buffers[j]));
+    work(&buffers[0]);
+    for(size_t j = 0; j < workers.size(); ++j)
+      workers[j].join();
+    for(size_t i = 0; i < count; ++i)
+      if(ok[i])
+        included += consider(loaded[i]);
+    if(Config::terminal)
+      progress();
+  }
+}
+
+// Read the headers of the article at PATH into A, using BUFFER as working
+// storage.  The buffer is kept from one article to the next and only grows.
+bool AllGroups::load(const string &path, vector<char> &buffer, Article &a) {
+  int fd;
+  ssize_t bytes_read;
+  size_t used = 0;
   struct stat sb;
-  char buffer[2048];
 
-  if((fd = open(path.c_str(), O_RDONLY)) < 0)
+  bool cold;
+
+  if((fd = open_article(path)) < 0)
     fatal(errno, "opening %s", path.c_str());
   if(fstat(fd, &sb) < 0)
     fatal(errno, "stat %s", path.c_str());
-  while((bytes_read = read(fd, buffer, sizeof buffer)) > 0) {
-    article.append(buffer, bytes_read);
-    if(article.find("\n\n") != string::npos
-       || article.find("\r\n\r\n") != string::npos)
+  // Read until we have all the headers
+  for(;;) {
+    if(buffer.size() - used < 2048)
+      buffer.resize(used + 2048);
+    if((bytes_read = read_article(fd, &buffer[used], buffer.size() - used,
+                                  used ? NULL : &cold))
+       <= 0)
+      break;
+    // Only search the new data (and enough of the old to catch a boundary)
+    const size_t from = used > 3 ? used - 3 : 0;
+    used += bytes_read;
+    if(memmem(&buffer[from], used - from, "\n\n", 2)
+       || memmem(&buffer[from], used - from, "\r\n\r\n", 4))
       break;
   }
   if(bytes_read < 0)
     fatal(errno, "reading %s", path.c_str());
-  close(fd);
+  close_article(fd, used, cold);
   if(debug)
     cerr << "article " << path << endl;
   // Parse article
-  Article a(article, sb.st_size);
+  a.parse(buffer.data(), used, sb.st_size);
   // Reject malformed articles
   if(!a.valid())
-    return 0;
+    return false;
   // Reject articles outside the sampling range
   if(a.date() < Config::start_time || a.date() >= Config::end_time)
+    return false;
+  return true;
+}
+
+// Visit one article by name
+int AllGroups::visit(const string &path) {
+  if(!load(path, buffer, parsed))
     return 0;
+  return consider(parsed);
+}
+
+// Credit a loaded article, if it hasn't been seen before
+int AllGroups::consider(const Article &a) {
+  if(records)
+    return record(a);
   // Only visit each article once
-  if(seen.find(a.mid()) != seen.end())
+  const bool fresh = seen.insert(a.mid()).second;
+  if(current) {
+    // Streaming: the whole-spool totals are credited the first time the
+    // article is seen anywhere, but the hierarchy the first time it is seen
+    // in that hierarchy.
+    if(fresh)
+      visit(&a);
+    if(!current_seen.insert(a.mid()).second)
+      return 0;
+    return accept(a, current);
+  }
+  if(!fresh)
     return 0;
-  seen.insert(a.mid());
+  int visited = accept(a);
+  // Supply the article to any shorter windows that it falls within
+  for(size_t n = 0; n < windows.size(); ++n)
+    if(a.date() >= windows[n]->window_start)
+      visited |= windows[n]->accept(a);
+  return visited;
+}
+
+// Credit a new article to this window
+int AllGroups::accept(const Article &a, const Hierarchy *only) {
   // Supply article to global bucket (AllGroups)
-  visit(&a);
+  if(!only)
+    visit(&a);
   // Get list of groups
-  vector<string> groups;
-  a.get_groups(groups);
+  const size_t ngroups = a.get_groups(groups);
   // Order the list, so we can easily de-dupe
-  sort(groups.begin(), groups.end());
+  sort(groups.begin(), groups.begin() + ngroups);
   const Hierarchy *last_h = NULL;
   int visited = 0;
-  for(size_t n = 0; n < groups.size(); ++n) {
+  for(size_t n = 0; n < ngroups; ++n) {
     // De-dupe groups
     if(n > 0 && groups[n - 1] == groups[n])
       continue;
     // Identify hierarchy
-    const string hname(groups[n], 0, groups[n].find('.'));
+    hname.assign(groups[n], 0, groups[n].find('.'));
     // Eliminate unwanted hierarchies
-    const map<string, Hierarchy *>::const_iterator it =
-        Config::hierarchies.find(hname); // TODO encapsulate in Config
-    if(it == Config::hierarchies.end())
+    const map<string, Hierarchy *>::const_iterator it = hierarchies.find(hname);
+    if(it == hierarchies.end())
       continue;
     Hierarchy *const h = it->second;
+    if(only && h != only)
+      continue;
     // Add to group data
-    h->group(groups[n])->visit(&a);
+    Group *const g = h->group(groups[n]);
+    g->visit(&a);
+    for(size_t k = 0; k < analyzers.size(); ++k) {
+      if(k == g->states.size())
+        g->states.push_back(analyzers[k]->create());
+      g->states[k]->visit(&a);
+    }
     visited = 1;
     // De-dupe hierarchy
     if(h == last_h)
@@ -175,6 +524,445 @@ int AllGroups::visit(const string &path) {
   return visited;
 }
 
+// Emit records for an article.  Duplicates are only found in replay(), so
+// an article seen in several groups' directories is counted each time by
+// the progress display.
+int AllGroups::record(const Article &a) {
+  ArticleRecord r;
+  r.mid = hash64(a.mid());
+  r.sender = hash64(a.sender());
+  r.group = 0;
+  r.useragent = useragent_ids.intern(a.useragent());
+  r.charset = charset_ids.intern(a.charset());
+  r.bytes = a.get_size();
+  add(r);
+  // Duplicate groups (and articles) are eliminated in replay()
+  const size_t ngroups = a.get_groups(groups);
+  int visited = 0;
+  for(size_t n = 0; n < ngroups; ++n) {
+    hname.assign(groups[n], 0, groups[n].find('.'));
+    const map<string, Hierarchy *>::const_iterator it = hierarchies.find(hname);
+    if(it == hierarchies.end())
+      continue;
+    r.group = 1 + group_id(it->second, groups[n]);
+    add(r);
+    visited = 1;
+  }
+  return visited;
+}
+
+// Find the ID for a group
+uint32_t AllGroups::group_id(Hierarchy *h, const string &name) {
+  const uint32_t id = group_ids.intern(name);
+  if(id == group_refs.size()) {
+    GroupRef ref;
+    ref.h = h;
+    ref.hid = find(hierarchy_refs.begin(), hierarchy_refs.end(), h)
+              - hierarchy_refs.begin();
+    if(ref.hid == hierarchy_refs.size())
+      hierarchy_refs.push_back(h);
+    ref.g = h->group(name);
+    group_refs.push_back(ref);
+  }
+  return id;
+}
+
+// Credit the recorded articles to buckets
+void AllGroups::replay() {
+  // Sender counts need a second sort, which takes the other half of the
+  // memory allowance
+  ExternalSorter<SenderRecord> senders(Config::spill_dir,
+                                       Config::max_memory / 2);
+  SenderRecord s;
+  vector<uint32_t> hierarchies_seen;
+  const ArticleRecord *last = NULL;
+  ArticleRecord previous;
+  records->merge([&](const ArticleRecord &r) {
+    const bool same_article = last && r.mid == last->mid;
+    // Each (article, group) pair appears once for every time the article was
+    // visited, and group 0 sorts first
+    if(same_article && r.group == last->group)
+      return;
+    previous = r;
+    last = &previous;
+    s.sender = r.sender;
+    if(r.group == 0) {
+      hierarchies_seen.clear();
+      credit(r.bytes);
+      ++useragents.value(useragent_ids.name(r.useragent)).articles;
+      ++charsets.value(charset_ids.name(r.charset)).articles;
+      s.kind = sender_useragent;
+      s.id = r.useragent;
+      senders.add(s);
+      s.kind = sender_charset;
+      s.id = r.charset;
+      senders.add(s);
+      return;
+    }
+    const GroupRef &ref = group_refs[r.group - 1];
+    ref.g->credit(r.bytes);
+    s.kind = sender_group;
+    s.id = r.group - 1;
+    senders.add(s);
+    if(find(hierarchies_seen.begin(), hierarchies_seen.end(), ref.hid)
+       != hierarchies_seen.end())
+      return;
+    hierarchies_seen.push_back(ref.hid);
+    ref.h->credit(r.bytes);
+    s.kind = sender_hierarchy;
+    s.id = ref.hid;
+    senders.add(s);
+  });
+  // Count distinct senders in each scope
+  const SenderRecord *prev = NULL;
+  SenderRecord held;
+  size_t count = 0;
+  auto flush = [&]() {
+    switch(prev->kind) {
+    case sender_group: group_refs[prev->id].g->senderCount = count; break;
+    case sender_hierarchy: hierarchy_refs[prev->id]->senderCount = count; break;
+    case sender_useragent:
+      useragents.value(useragent_ids.name(prev->id)).senderCount = count;
+      break;
+    case sender_charset:
+      charsets.value(charset_ids.name(prev->id)).senderCount = count;
+      break;
+    }
+  };
+  senders.merge([&](const SenderRecord &r) {
+    if(prev && r.kind == prev->kind && r.id == prev->id) {
+      if(r.sender != prev->sender)
+        ++count;
+    } else {
+      if(prev)
+        flush();
+      count = 1;
+    }
+    held = r;
+    prev = &held;
+  });
+  if(prev)
+    flush();
+  if(Config::terminal && records->spilled())
+    cerr << "spilled " << records->spilled() << " runs to "
+         << Config::spill_dir << "\n";
+}
+
+// Write partial results
+void AllGroups::emit(const string &path) {
+  PartialWriter w(path);
+  w.u64(Config::end_time);
+  w.u32(Config::days);
+  save_names(w);
+  save_records(w);
+  w.close();
+}
+
+// Write the hierarchies and the name tables to W
+void AllGroups::save_names(PartialWriter &w) {
+  w.u32(hierarchies.size());
+  for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+      it != hierarchies.end(); ++it)
+    w.str(it->first);
+  w.u32(group_ids.size());
+  for(size_t n = 0; n < group_ids.size(); ++n)
+    w.str(group_ids.name(n));
+  w.u32(useragent_ids.size());
+  for(size_t n = 0; n < useragent_ids.size(); ++n)
+    w.str(useragent_ids.name(n));
+  w.u32(charset_ids.size());
+  for(size_t n = 0; n < charset_ids.size(); ++n)
+    w.str(charset_ids.name(n));
+}
+
+// Write the records to W, leaving the sorter empty
+void AllGroups::save_records(PartialWriter &w) {
+  // The records are written in order with duplicates removed; the count is
+  // filled in at the end
+  const long count_offset = w.tell();
+  uint64_t count = 0;
+  w.u64(0);
+  ArticleRecord last;
+  records->merge([&](const ArticleRecord &r) {
+    if(count && r.mid == last.mid && r.group == last.group)
+      return;
+    w.record(r);
+    last = r;
+    ++count;
+  });
+  w.patch(count_offset, count);
+}
+
+// Read one table of names from a partial and intern them
+static void read_names(PartialReader &r, Interner &ids,
+                       vector<uint32_t> &local) {
+  local.resize(r.u32());
+  for(size_t n = 0; n < local.size(); ++n)
+    local[n] = ids.intern(r.str());
+}
+
+// Read partial results
+void AllGroups::merge(const vector<string> &paths) {
+  vector<uint32_t> gmap, umap, cmap;
+  for(size_t n = 0; n < paths.size(); ++n) {
+    PartialReader r(paths[n]);
+    const time_t end_time = r.u64();
+    const int days = r.u32();
+    if(n == 0)
+      Config::days = days;
+    else if(days != Config::days)
+      fatal(0, "%s: covers %d days, not %d", paths[n].c_str(), days,
+            Config::days);
+    if(n == 0 || end_time > Config::end_time)
+      Config::end_time = end_time;
+    load_names(r, gmap, umap, cmap);
+    load_records(r, r.u64(), gmap, umap, cmap);
+  }
+  Config::start_time = Config::end_time - 86400 * Config::days;
+  if(Config::emit_partial.empty())
+    replay();
+}
+
+// Read hierarchies and name tables written by save_names().  GMAP, UMAP and
+// CMAP are filled in with the IDs that the file's group, user agent and
+// character set IDs correspond to.
+void AllGroups::load_names(PartialReader &r, vector<uint32_t> &gmap,
+                           vector<uint32_t> &umap, vector<uint32_t> &cmap) {
+  for(uint32_t i = r.u32(); i > 0; --i) {
+    const string name = r.str();
+    if(hierarchies.find(name) == hierarchies.end())
+      hierarchies[name] = new Hierarchy(name);
+  }
+  gmap.resize(r.u32());
+  for(size_t i = 0; i < gmap.size(); ++i) {
+    const string name = r.str();
+    const map<string, Hierarchy *>::const_iterator it =
+        hierarchies.find(name.substr(0, name.find('.')));
+    if(it == hierarchies.end())
+      fatal(0, "%s: group %s is not in any hierarchy", r.path.c_str(),
+            name.c_str());
+    gmap[i] = group_id(it->second, name);
+  }
+  read_names(r, useragent_ids, umap);
+  read_names(r, charset_ids, cmap);
+}
+
+// Read COUNT records from R, mapping IDs as returned by load_names()
+void AllGroups::load_records(PartialReader &r, uint64_t count,
+                             const vector<uint32_t> &gmap,
+                             const vector<uint32_t> &umap,
+                             const vector<uint32_t> &cmap) {
+  ArticleRecord a;
+  for(uint64_t i = count; i > 0; --i) {
+    r.record(a);
+    if(a.group > gmap.size() || a.useragent >= umap.size()
+       || a.charset >= cmap.size())
+      fatal(0, "%s: corrupt partial", r.path.c_str());
+    if(a.group)
+      a.group = 1 + gmap[a.group - 1];
+    a.useragent = umap[a.useragent];
+    a.charset = cmap[a.charset];
+    records->add(a);
+  }
+}
+
+// Add a record, and with --checkpoint write it to the current segment
+void AllGroups::add(const ArticleRecord &r) {
+  records->add(r);
+  if(segment) {
+    segment->record(r);
+    ++segment_records;
+  }
+}
+
+// Path of a checkpoint segment
+string AllGroups::segment_path(uint32_t n) {
+  return Config::checkpoint + "." + to_string(n);
+}
+
+// Start writing the next checkpoint segment.  After a --resume this
+// replaces anything left by the interrupted scan.
+void AllGroups::start_segment() {
+  segment = new PartialWriter(segment_path(segments.size()),
+                              "checkpoint segment");
+  segment_records = 0;
+}
+
+// Wait until the entries in the directory containing PATH are on disk
+static void sync_parent(const string &path) {
+  const size_t slash = path.rfind('/');
+  const string dir = slash == string::npos ? "." : path.substr(0, slash);
+  int fd;
+  if((fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY)) < 0)
+    fatal(errno, "opening %s", dir.c_str());
+  if(fsync(fd) < 0)
+    fatal(errno, "syncing %s", dir.c_str());
+  close(fd);
+}
+
+// Write a checkpoint (--checkpoint).
+//
+// The records made since the last checkpoint are in the current segment,
+// so only that is finished off here; the checkpoint file itself holds the
+// counters, the finished directories, the name tables and the number of
+// records in each segment.  It is written under a temporary name and
+// renamed into place, so an interruption leaves the previous one intact.
+void AllGroups::checkpoint() {
+  segment->close(true);
+  delete segment;
+  segment = NULL;
+  segments.push_back(segment_records);
+  const string tmp = Config::checkpoint + ".new";
+  PartialWriter w(tmp, "checkpoint");
+  w.u64(Config::end_time);
+  w.u32(Config::days);
+  w.str(Config::spool);
+  w.str(Config::active);
+  w.u32(Config::shard);
+  w.u32(Config::shards);
+  w.u64(committed.files);
+  w.u64(committed.included);
+  w.u64(committed.skip_lwm);
+  w.u64(committed.skip_mtime);
+  w.u64(committed.dirs);
+  w.u32(done.size());
+  for(set<string>::const_iterator it = done.begin(); it != done.end(); ++it)
+    w.str(*it);
+  save_names(w);
+  w.u32(segments.size());
+  for(size_t n = 0; n < segments.size(); ++n)
+    w.u64(segments[n]);
+  w.close(true);
+  if(rename(tmp.c_str(), Config::checkpoint.c_str()) < 0)
+    fatal(errno, "renaming %s", tmp.c_str());
+  sync_parent(Config::checkpoint);
+  start_segment();
+  next_checkpoint = time(NULL) + Config::checkpoint_interval;
+}
+
+// Pick up from a checkpoint (--resume).  Returns false if there isn't one.
+bool AllGroups::resume() {
+  const string &path = Config::checkpoint;
+  if(access(path.c_str(), F_OK) < 0) {
+    if(errno == ENOENT)
+      return false;
+    fatal(errno, "checking %s", path.c_str());
+  }
+  PartialReader r(path, "checkpoint");
+  // The interval is the one the interrupted scan started with
+  Config::end_time = r.u64();
+  const int days = r.u32();
+  const string spool = r.str(), active = r.str();
+  const unsigned shard = r.u32(), shards = r.u32();
+  if(days != Config::days || spool != Config::spool
+     || active != Config::active || shard != Config::shard
+     || shards != Config::shards)
+    fatal(0, "%s: checkpoint is from a different scan", path.c_str());
+  Config::start_time = Config::end_time - 86400 * Config::days;
+  Config::start_mtime = Config::start_time - Config::start_latency;
+  committed.files = r.u64();
+  committed.included = r.u64();
+  committed.skip_lwm = r.u64();
+  committed.skip_mtime = r.u64();
+  committed.dirs = r.u64();
+  files = committed.files;
+  included = committed.included;
+  skip_lwm = committed.skip_lwm;
+  skip_mtime = committed.skip_mtime;
+  dirs = committed.dirs;
+  for(uint32_t n = r.u32(); n > 0; --n)
+    done.insert(r.str());
+  vector<uint32_t> gmap, umap, cmap;
+  load_names(r, gmap, umap, cmap);
+  if(hierarchies.size() != Config::hierarchies.size())
+    fatal(0, "%s: checkpoint is from a different scan", path.c_str());
+  // Nothing has been interned yet, so the IDs are unchanged, and records
+  // made from here on can go in further segments alongside the old ones
+  for(size_t n = 0; n < gmap.size(); ++n)
+    assert(gmap[n] == n);
+  for(size_t n = 0; n < umap.size(); ++n)
+    assert(umap[n] == n);
+  for(size_t n = 0; n < cmap.size(); ++n)
+    assert(cmap[n] == n);
+  segments.resize(r.u32());
+  for(size_t n = 0; n < segments.size(); ++n)
+    segments[n] = r.u64();
+  for(size_t n = 0; n < segments.size(); ++n) {
+    PartialReader s(segment_path(n), "checkpoint segment");
+    load_records(s, segments[n], gmap, umap, cmap);
+  }
+  return true;
+}
+
+// Remove the checkpoint file and its segments
+void AllGroups::remove_checkpoint() {
+  if(unlink(Config::checkpoint.c_str()) < 0 && errno != ENOENT)
+    fatal(errno, "removing %s", Config::checkpoint.c_str());
+  for(uint32_t n = 0;; ++n) {
+    const string path = segment_path(n);
+    if(unlink(path.c_str()) < 0) {
+      if(errno == ENOENT)
+        break;
+      fatal(errno, "removing %s", path.c_str());
+    }
+  }
+}
+
+// The results of the scan have been written, so there's nothing to resume
+void AllGroups::forget_checkpoint() {
+  if(Config::checkpoint.empty())
+    return;
+  delete segment;
+  segment = NULL;
+  remove_checkpoint();
+}
+
+// Current values of the progress counters
+AllGroups::Counts AllGroups::counts() const {
+  Counts c;
+  c.files = files;
+  c.included = included;
+  c.skip_lwm = skip_lwm;
+  c.skip_mtime = skip_mtime;
+  c.dirs = dirs;
+  return c;
+}
+
+// Note that a directory is being started, so that finished() can tell what
+// it (and anything below it) added to the counters
+void AllGroups::starting() {
+  if(Config::checkpoint.empty())
+    return;
+  started.push_back(make_pair(counts(), committed));
+}
+
+// Note that DIR has been scanned, along with its subdirectories if SUBDIRS
+// is set, and write a checkpoint if one is due
+void AllGroups::finished(const string &dir, bool subdirs) {
+  if(Config::checkpoint.empty())
+    return;
+  // What was committed when DIR was started, plus everything counted since
+  const Counts now = counts(), &then = started.back().first;
+  Counts &c = started.back().second;
+  c.files += now.files - then.files;
+  c.included += now.included - then.included;
+  c.skip_lwm += now.skip_lwm - then.skip_lwm;
+  c.skip_mtime += now.skip_mtime - then.skip_mtime;
+  c.dirs += now.dirs - then.dirs;
+  committed = c;
+  started.pop_back();
+  if(subdirs) {
+    // Only the top of a finished tree need be remembered
+    const string prefix = dir + "/";
+    set<string>::iterator it = done.lower_bound(prefix);
+    while(it != done.end() && it->compare(0, prefix.size(), prefix) == 0)
+      done.erase(it++);
+  }
+  done.insert(dir);
+  if(time(NULL) >= next_checkpoint)
+    checkpoint();
+}
+
 // Generate all reports
 void AllGroups::report() {
   report_hierarchies();
@@ -182,11 +970,13 @@ void AllGroups::report() {
   report_agents((Config::output + "/agents.html"), false);
   report_agents((Config::output + "/agents-summary.html"), true);
   report_charsets();
-  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
-      it != Config::hierarchies.end(); ++it) {
-    Hierarchy *const h = it->second;
-    h->page();
-  }
+  // With --stream, hierarchies were reported as they were finished
+  if(!Config::stream)
+    for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+        it != hierarchies.end(); ++it) {
+      Hierarchy *const h = it->second;
+      h->page();
+    }
 }
 
 void AllGroups::report_hierarchies() {
@@ -211,9 +1001,8 @@ void AllGroups::report_hierarchies() {
     HTML::thead(os, "Hierarchy", "Articles/day", "Bytes/day", "Posters",
                 (const char *)NULL);
 
-    for(map<string, Hierarchy *>::const_iterator it =
-            Config::hierarchies.begin();
-        it != Config::hierarchies.end(); ++it) {
+    for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+        it != hierarchies.end(); ++it) {
       Hierarchy *const h = it->second;
       h->summary(os);
     }
@@ -226,8 +1015,10 @@ void AllGroups::report_hierarchies() {
     os << "<td><a href=" << HTML::Quote("allgroups.html") << ">"
        << "All groups</a></td>\n";
     os << "<td>" << setprecision(total_arts_per_day >= 10 ? 0 : 1)
-       << total_arts_per_day << setprecision(6) << "</td>\n";
-    os << "<td>" << round_kilo(total_bytes_per_day) << "</td>\n";
+       << total_arts_per_day << setprecision(6)
+       << plus_minus(articles_error / Config::days) << "</td>\n";
+    os << "<td>" << round_kilo(total_bytes_per_day)
+       << plus_minus(bytes_error / Config::days, true) << "</td>\n";
     os << "</tr>\n";
     os << "</tfoot>\n";
     os << "</table>\n";
@@ -253,9 +1044,8 @@ void AllGroups::report_groups() {
     HTML::thead(os, "Group", "Articles/day", "Bytes/day", "Posters",
                 (const char *)NULL);
 
-    for(map<string, Hierarchy *>::const_iterator jt =
-            Config::hierarchies.begin();
-        jt != Config::hierarchies.end(); ++jt) {
+    for(map<string, Hierarchy *>::const_iterator jt = hierarchies.begin();
+        jt != hierarchies.end(); ++jt) {
       Hierarchy *const h = jt->second;
       for(map<string, Group *>::const_iterator it = h->groups.begin();
           it != h->groups.end(); ++it) {
@@ -271,8 +1061,10 @@ void AllGroups::report_groups() {
     os << "<tr>\n";
     os << "<td>Total</td>\n";
     os << "<td>" << setprecision(total_arts_per_day >= 10 ? 0 : 1)
-       << total_arts_per_day << setprecision(6) << "</td>\n";
-    os << "<td>" << round_kilo(total_bytes_per_day) << "</td>\n";
+       << total_arts_per_day << setprecision(6)
+       << plus_minus(articles_error / Config::days) << "</td>\n";
+    os << "<td>" << round_kilo(total_bytes_per_day)
+       << plus_minus(bytes_error / Config::days, true) << "</td>\n";
     os << "<td></td>\n"; // TODO?
     os << "</tr>\n";
     os << "</tfoot>\n";
@@ -286,17 +1078,20 @@ void AllGroups::report_groups() {
 }
 
 void AllGroups::logs() {
-  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
-      it != Config::hierarchies.end(); ++it) {
-    Hierarchy *const h = it->second;
-    h->logs();
-  }
+  if(!Config::stream)
+    for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+        it != hierarchies.end(); ++it) {
+      Hierarchy *const h = it->second;
+      h->logs();
+    }
   try {
     ofstream os((Config::output + "/all.csv").c_str(), ios::app);
     os.exceptions(ofstream::badbit | ofstream::failbit);
     os << Config::end_time << ',' << Config::days * 86400 << ',' << bytes << ','
-       << articles << '\n'
-       << flush;
+       << articles;
+    if(Config::sample)
+      os << ',' << llround(bytes_error) << ',' << llround(articles_error);
+    os << '\n' << flush;
   } catch(ios::failure &) {
     fatal(errno, "writing to %s", (Config::output + "/all.csv").c_str());
   }
@@ -304,9 +1099,34 @@ void AllGroups::logs() {
   useragents.logs(Config::output + "/useragents.csv");
 }
 
+void AllGroups::analyses() {
+  for(size_t k = 0; k < analyzers.size(); ++k) {
+    Analyzer::States group_states, hierarchy_states;
+    vector<Analyzer::State *> merged;
+    for(map<string, Hierarchy *>::const_iterator jt = hierarchies.begin();
+        jt != hierarchies.end(); ++jt) {
+      Hierarchy *const h = jt->second;
+      Analyzer::State *const hs = analyzers[k]->create();
+      merged.push_back(hs);
+      for(map<string, Group *>::const_iterator it = h->groups.begin();
+          it != h->groups.end(); ++it) {
+        const Group *g = it->second;
+        if(k < g->states.size()) {
+          group_states[g->name] = g->states[k];
+          hs->merge(*g->states[k]);
+        }
+      }
+      hierarchy_states[h->name] = hs;
+    }
+    analyzers[k]->report(group_states, hierarchy_states);
+    for(size_t n = 0; n < merged.size(); ++n)
+      delete merged[n];
+  }
+}
+
 void AllGroups::readLogs() {
-  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
-      it != Config::hierarchies.end(); ++it) {
+  for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+      it != hierarchies.end(); ++it) {
     Hierarchy *const h = it->second;
     h->readLogs();
   }
@@ -316,18 +1136,24 @@ void AllGroups::readLogs() {
     const vector<Value> &last = rows.back();
     bytes = last[2];
     articles = last[3];
+    if(last.size() > 5) {
+      bytes_error = (intmax_t)last[4];
+      articles_error = (intmax_t)last[5];
+    }
   }
   charsets.readLogs(Config::output + "/encodings.csv");
   useragents.readLogs(Config::output + "/useragents.csv");
 }
 
 void AllGroups::graphs() {
-  for(map<string, Hierarchy *>::const_iterator it = Config::hierarchies.begin();
-      it != Config::hierarchies.end(); ++it) {
-    Hierarchy *const h = it->second;
-    h->graphs();
-  }
-  graph("All groups", Config::output + "/all.csv", Config::output + "/all.png");
+  if(!Config::stream)
+    for(map<string, Hierarchy *>::const_iterator it = hierarchies.begin();
+        it != hierarchies.end(); ++it) {
+      Hierarchy *const h = it->second;
+      h->graphs();
+    }
+  graph("All groups", Config::output + "/all.csv", Config::output + "/all.png",
+        4);
 }
 
 void AllGroups::report_agents(const std::string &path, bool summarized) {
@@ -354,9 +1180,11 @@ void AllGroups::report_agents(const std::string &path, bool summarized) {
       os << "<tr>\n";
       os << "<td>" << HTML::Escape(agents[n]->value) << "</td>\n";
       os << "<td sorttable_customkey=-" << fixed << agents[n]->articles << ">"
-         << agents[n]->articles << "</td>\n";
+         << agents[n]->articles << plus_minus(agents[n]->articles_error)
+         << "</td>\n";
       os << "<td sorttable_customkey=-" << fixed << agents[n]->senderCount
-         << ">" << agents[n]->senderCount << "</td>\n";
+         << ">" << agents[n]->senderCount
+         << plus_minus(agents[n]->senders_error) << "</td>\n";
       os << "</tr>\n";
     }
 
@@ -387,9 +1215,11 @@ void AllGroups::report_charsets() {
       os << "<tr>\n";
       os << "<td>" << HTML::Escape(charsets_o[n]->value) << "</td>\n";
       os << "<td sorttable_customkey=-" << fixed << charsets_o[n]->articles
-         << ">" << charsets_o[n]->articles << "</td>\n";
+         << ">" << charsets_o[n]->articles
+         << plus_minus(charsets_o[n]->articles_error) << "</td>\n";
       os << "<td sorttable_customkey=-" << fixed << charsets_o[n]->senderCount
-         << ">" << charsets_o[n]->senderCount << "</td>\n";
+         << ">" << charsets_o[n]->senderCount
+         << plus_minus(charsets_o[n]->senders_error) << "</td>\n";
       os << "</tr>\n";
     }
 
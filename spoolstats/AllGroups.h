@@ -22,10 +22,16 @@
 #define ALL_H
 
 class Hierarchy;
+class Group;
+struct ActiveGroup;
+class PartialWriter;
+class PartialReader;
 
 class AllGroups: public Bucket {
 public:
-  AllGroups(): skip_lwm(0), skip_mtime(0), dirs(0) {}
+  // Report on articles dated from START onwards.  The hierarchies are shared
+  // with Config::hierarchies unless FRESH is set.
+  AllGroups(time_t start, bool fresh = false);
 
   ~AllGroups();
 
@@ -35,9 +41,28 @@ public:
   // Scan the spool
   void scan();
 
+  // Also supply articles to W during the scan.  W's window must be no longer
+  // than this one's.
+  inline void route(AllGroups *w) {
+    windows.push_back(w);
+  }
+
+  // Write partial results to PATH (--emit-partial)
+  void emit(const std::string &path);
+
+  // Read partial results from PATHS (--merge)
+  void merge(const std::vector<std::string> &paths);
+
+  // Remove the checkpoint (--checkpoint), once the results of the scan have
+  // been written
+  void forget_checkpoint();
+
   // Generate logs
   void logs();
 
+  // Generate reports for the extra analyses
+  void analyses();
+
   // Read logs
   void readLogs();
 
@@ -47,19 +72,177 @@ public:
   // Generate all reports
   void report();
 
+  // Summarize a user-agent name
+  static const std::string &summarize(const std::string &);
+
 private:
+  // Hierarchies to analyse
+  std::map<std::string, Hierarchy *> hierarchies;
+
+  // Start of this window, and the shorter windows fed from this one
+  const time_t window_start;
+  std::vector<AllGroups *> windows;
+
   // Message IDs that have been seen
   std::set<std::string> seen;
 
+  // With --stream, the hierarchy being scanned, the message IDs seen in it,
+  // and the thread reporting on the previous one
+  Hierarchy *current;
+  std::set<std::string> current_seen;
+  std::thread reporter;
+
+  // Per-article working storage, reused from one article to the next
+  std::vector<char> buffer;
+  Article parsed;
+  std::vector<std::string> groups;
+  std::string hname;
+
   ArticleProperty useragents;
   ArticleProperty charsets;
 
+  // Extra analyses (--analyze)
+  std::vector<Analyzer *> analyzers;
+
+  // External-memory mode (--max-memory, and also used for partial results).
+  // Instead of being credited to buckets as it is found, each article is
+  // reduced to ArticleRecords, which are sorted (spilling to disk as
+  // necessary) and replayed at the end of the scan.  NULL in normal
+  // operation.
+  ExternalSorter<ArticleRecord> *records;
+
+  // Directories completely scanned, for --checkpoint.  When a whole tree is
+  // finished only its top is listed.
+  std::set<std::string> done;
+
+  // When the next checkpoint is due
+  time_t next_checkpoint;
+
+  // With --checkpoint, the records are also written to a series of segment
+  // files as they are made (see checkpoint()).  The number of records in
+  // each finished segment, and the segment being written (if any) with the
+  // number written to it so far.
+  std::vector<uint64_t> segments;
+  PartialWriter *segment;
+  uint64_t segment_records;
+
+  // Add a record, and write it to the checkpoint segment if there is one
+  void add(const ArticleRecord &r);
+
+  // Progress counters (as shown by progress())
+  struct Counts {
+    long files, included, skip_lwm, skip_mtime, dirs;
+  };
+  Counts counts() const;
+
+  // The counters for the directories in done, which is what a checkpoint
+  // records.  A directory that was part-way through is scanned again after
+  // a --resume, so its counts must not be saved twice.
+  Counts committed;
+
+  // The counters and the committed counters when each directory being
+  // scanned was started; see finished()
+  std::vector<std::pair<Counts, Counts>> started;
+
+  // Kinds of SenderRecord
+  enum { sender_group, sender_hierarchy, sender_useragent, sender_charset };
+
+  // Names and destinations of the IDs in ArticleRecords
+  struct GroupRef {
+    Hierarchy *h;
+    uint32_t hid; // index into hierarchy_refs
+    Group *g;
+  };
+  Interner group_ids;
+  std::vector<GroupRef> group_refs;
+  std::vector<Hierarchy *> hierarchy_refs;
+  Interner useragent_ids;
+  Interner charset_ids;
+
+  // Emit records for an article.  Returns 1 if article used, else 0, even
+  // if it has been seen before.
+  int record(const Article &a);
+
+  // Find the ID for a group
+  uint32_t group_id(Hierarchy *h, const std::string &name);
+
+  // Credit the recorded articles to buckets
+  void replay();
+
+  // Write or read hierarchies and name tables.  load_names() fills in maps
+  // from the IDs in the file to the IDs in use.
+  void save_names(PartialWriter &w);
+  void load_names(PartialReader &r, std::vector<uint32_t> &gmap,
+                  std::vector<uint32_t> &umap, std::vector<uint32_t> &cmap);
+
+  // Write a count and then the records, consuming them; or read COUNT
+  // records, mapping their IDs
+  void save_records(PartialWriter &w);
+  void load_records(PartialReader &r, uint64_t count,
+                    const std::vector<uint32_t> &gmap,
+                    const std::vector<uint32_t> &umap,
+                    const std::vector<uint32_t> &cmap);
+
+  // Path of checkpoint segment N
+  static std::string segment_path(uint32_t n);
+
+  // Start writing a new checkpoint segment
+  void start_segment();
+
+  // Write a checkpoint
+  void checkpoint();
+
+  // Remove the checkpoint files
+  static void remove_checkpoint();
+
+  // Restore state from a checkpoint.  Returns false if there isn't one.
+  bool resume();
+
+  // Note that the scan of a directory is starting
+  void starting();
+
+  // Note that DIR has been scanned (and if SUBDIRS is set, everything below
+  // it), and write a checkpoint if one is due.  Matches the last call to
+  // starting().
+  void finished(const std::string &dir, bool subdirs);
+
+  // Scale up everything from a --sample scan
+  void estimate();
+
   // Recurse into one directory
   void recurse(const std::string &dir);
 
+  // Scan a very large directory DIR, open on FD.  Symlinks in ENTRIES are
+  // given the inode number of what they point to.
+  void large(int fd, const std::string &dir,
+             std::vector<DirectoryEntry> &entries, bool mine);
+
+  // Scan one group from the active file (--active)
+  void scan_group(const ActiveGroup &g);
+
+  // Visit the articles NAMES (number, entry) in DIR, open on FD
+  void visit_articles(
+      int fd, const std::string &dir,
+      std::vector<std::pair<long, const DirectoryEntry *>> &names);
+
+  // Read and parse the article at PATH into A.  Returns true if it is valid
+  // and in the sampling interval.  May be called from any thread.
+  static bool load(const std::string &path, std::vector<char> &buffer,
+                   Article &a);
+
+  // Credit a loaded article.  Returns 1 if article used, else 0.
+  int consider(const Article &a);
+
+  // Report progress on the terminal
+  void progress();
+
   // Visit one article by name.  Returns 1 if article used, else 0.
   int visit(const std::string &path);
 
+  // Credit a new article to this window, or if ONLY is not NULL then just
+  // to that hierarchy.  Returns 1 if article used, else 0.
+  int accept(const Article &a, const Hierarchy *only = NULL);
+
   // Generate the hierarchies report
   void report_hierarchies();
 
@@ -72,9 +255,8 @@ private:
   // Generate the charsets report
   void report_charsets();
 
-  // Summarize a user-agent name
-  static const std::string &summarize(const std::string &);
-
+  long files;
+  long included;
   long skip_lwm;
   long skip_mtime;
   long dirs;
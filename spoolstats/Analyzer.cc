@@ -0,0 +1,36 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+
+using namespace std;
+
+Analyzer::State::~State() {}
+
+Analyzer::~Analyzer() {}
+
+Analyzer *Analyzer::find(const string &name) {
+  if(name == "references")
+    return new ReferencesAnalyzer();
+  if(name == "followups")
+    return new FollowupAnalyzer();
+  if(name == "liveness")
+    return new LivenessAnalyzer();
+  return NULL;
+}
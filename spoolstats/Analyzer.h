@@ -0,0 +1,102 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+class Article;
+
+// An additional analysis performed during the spool scan (--analyze).  It
+// sees each new article once per wanted group it is in, after the normal
+// accounting, so it costs no extra spool walking or header parsing.
+class Analyzer {
+public:
+  // What the analyzer knows about one group.  A hierarchy's state is made by
+  // merging the states of its groups, so an article crossposted to several
+  // groups counts once for each of them.
+  class State {
+  public:
+    virtual ~State();
+
+    // Supply one article from the group
+    virtual void visit(const Article *a) = 0;
+
+    // Fold THAT (from the same analyzer) into this state
+    virtual void merge(const State &that) = 0;
+  };
+
+  // Group or hierarchy names and their states
+  typedef std::map<std::string, State *> States;
+
+  virtual ~Analyzer();
+
+  // Create an empty state
+  virtual State *create() const = 0;
+
+  // Write reports to the output directory.  The states are not used again
+  // afterwards, so the report may modify them.
+  virtual void report(const States &groups, const States &hierarchies) = 0;
+
+  // Create the analyzer called NAME, or return NULL if there is no such
+  // analyzer
+  static Analyzer *find(const std::string &name);
+};
+
+class ReferencesAnalyzer: public Analyzer {
+public:
+  State *create() const;
+  void report(const States &groups, const States &hierarchies);
+};
+
+class FollowupAnalyzer: public Analyzer {
+public:
+  State *create() const;
+  void report(const States &groups, const States &hierarchies);
+
+  // Intern a From: field, returning a sender ID
+  uint32_t sender(const std::string &from);
+
+  // Address of a sender
+  const std::string &address(uint32_t id) const {
+    return senders.name(id);
+  }
+
+  // Display name of a sender (or "")
+  const std::string &name(uint32_t id) const {
+    return names[id];
+  }
+
+private:
+  Interner senders;               // addresses
+  std::vector<std::string> names; // sender ID -> display name
+  std::string address_, name_;    // scratch space for sender()
+};
+
+class LivenessAnalyzer: public Analyzer {
+public:
+  State *create() const;
+
+  // Create a state with known totals
+  static State *state(long articles, time_t latest);
+
+  void report(const States &groups, const States &hierarchies);
+};
+
+#endif /* ANALYZER_H */
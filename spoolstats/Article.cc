@@ -21,92 +21,127 @@
 
 using namespace std;
 
-Article::Article(const string &text, size_t bytes_):
-    bytes(bytes_), cached_date(-1) {
-  parse(text);
+#define HEADER_NAME(name) {name, sizeof name - 1}
+
+const Article::HeaderName Article::header_names[h_count] = {
+    HEADER_NAME("message-id"),   HEADER_NAME("date"),
+    HEADER_NAME("from"),         HEADER_NAME("newsgroups"),
+    HEADER_NAME("user-agent"),   HEADER_NAME("x-newsreader"),
+    HEADER_NAME("x-mailer"),     HEADER_NAME("content-type"),
+    HEADER_NAME("references"),
+};
+
+Article::Article(): bytes(0), found(0), cached_date(-1) {}
+
+Article::Article(const string &text, size_t bytes_): Article() {
+  parse(text.data(), text.size(), bytes_);
 }
 
-void Article::get_groups(vector<string> &groups) const {
-  split(groups, ',', headers.find("newsgroups")->second);
+size_t Article::get_groups(vector<string> &groups) const {
+  size_t count = 0;
+  if(!present(h_newsgroups))
+    return 0;
+  const string &newsgroups = values[h_newsgroups];
+  string::size_type pos = 0, n;
+  do {
+    n = newsgroups.find(',', pos);
+    if(count == groups.size())
+      groups.push_back(string());
+    groups[count++].assign(newsgroups, pos,
+                           n == string::npos ? string::npos : n - pos);
+    pos = n + 1;
+  } while(n != string::npos);
+  return count;
 }
 
 time_t Article::date() const {
   if(cached_date == -1) {
-    auto it = headers.find("date");
-    assert(it != headers.end());
-    string datestr = it->second;
-    cached_date = parse_date(datestr, Config::terminal);
+    assert(present(h_date));
+    cached_date = parse_date(values[h_date], Config::terminal);
   }
   return cached_date;
 }
 
-void Article::parse(const string &text) {
-  string::size_type pos = 0;
+void Article::parse(const char *text, size_t len, size_t bytes_) {
+  size_t pos = 0;
 
-  while(pos < text.size()) {
-    if(eol(text, pos))
+  bytes = bytes_;
+  found = 0;
+  cached_date = -1;
+  while(pos < len) {
+    if(eol(text, len, pos))
       break; // end of headers
-    string::size_type header_end = pos;
-    while(header_end < text.size() && !eoh(text, header_end))
-      ++header_end;
-    if(header_end >= text.size()) // truncated, skip
+    // Find the end of the header, including any continuation lines
+    size_t header_end = pos, next;
+    for(;;) {
+      const char *nl = (const char *)memchr(text + header_end, '\n',
+                                            len - header_end);
+      if(!nl)
+        return; // truncated, skip
+      next = nl - text + 1;
+      if(next < len && (text[next] == ' ' || text[next] == '\t')) {
+        header_end = next;
+        continue;
+      }
+      header_end = nl - text;
+      if(header_end > pos && text[header_end - 1] == '\r')
+        --header_end;
       break;
-    // trim trailing whitespace
-    string header(text, pos, header_end - pos); // full header
-    pos = header_end + eol(text, header_end);   // after header+CRLF
-    string::size_type colon = header.find(':');
-    if(colon == string::npos)
+    }
+    const size_t start = pos;
+    pos = next; // after header+CRLF
+    const char *colon =
+        (const char *)memchr(text + start, ':', header_end - start);
+    if(!colon)
       continue; // bad header, skip
-    string name(header, 0, colon);
-    string::size_type s = header.find_first_not_of(" \t", colon + 1);
-    string::size_type e = header.size();
-    while(e < colon && (header[e - 1] == ' ' || header[e - 1] == '\t'))
-      --e;
-    if(s > e)
-      s = e;
-    string value(header, s, e - s);
-    headers[lower(name)] = value;
-    if(debug)
-      cerr << "  header " << name << endl
-           << "        '" << value << "'" << endl;
+    const size_t name_len = colon - (text + start);
+    size_t s = colon + 1 - text;
+    while(s < header_end && (text[s] == ' ' || text[s] == '\t'))
+      ++s;
+    if(debug) {
+      cerr << "  header ";
+      cerr.write(text + start, name_len) << endl << "        '";
+      cerr.write(text + s, header_end - s) << "'" << endl;
+    }
+    const int h = lookup(text + start, name_len);
+    if(h < 0)
+      continue; // not a header we care about
+    values[h].assign(text + s, header_end - s);
+    found |= 1u << h;
   }
 }
 
+// Identify a header name.  NAME need not be 0-terminated and may contain
+// 0 bytes, so the lengths are compared first.
+int Article::lookup(const char *name, size_t len) {
+  for(int h = 0; h < h_count; ++h)
+    if(len == header_names[h].len
+       && !strncasecmp(name, header_names[h].name, len))
+      return h;
+  return -1;
+}
+
 /// end of line?
-int Article::eol(const string &text, string::size_type pos) {
+int Article::eol(const char *text, size_t len, size_t pos) {
   // both LF and CRLF will do (so we can support wire-format and
   // native-format spools)
-  if(pos < text.size() && text[pos] == '\n')
+  if(pos < len && text[pos] == '\n')
     return 1;
-  if(pos + 1 < text.size() && text[pos] == '\r' && text[pos + 1] == '\n')
+  if(pos + 1 < len && text[pos] == '\r' && text[pos + 1] == '\n')
     return 2;
   return 0;
 }
 
-// end of header?
-int Article::eoh(const string &text, string::size_type pos) {
-  string::size_type n = eol(text, pos);
-  if(!n)
-    return 0;
-  pos += n;
-  if(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t'))
-    return 0;
-  return 1;
-}
-
 const string &Article::useragent() const {
-  map<string, string>::const_iterator it;
   static const string unknown = "(unknown)";
 
-  it = headers.find("user-agent");
-  if(it == headers.end())
-    it = headers.find("x-newsreader");
-  if(it == headers.end())
-    it = headers.find("x-mailer");
-  if(it == headers.end())
-    return unknown;
-  else
-    return it->second;
+  if(present(h_user_agent))
+    return values[h_user_agent];
+  if(present(h_x_newsreader))
+    return values[h_x_newsreader];
+  if(present(h_x_mailer))
+    return values[h_x_mailer];
+  return unknown;
 }
 
 const string Article::charset() const {
@@ -115,11 +150,9 @@ const string Article::charset() const {
   static const char tokenchars[] =
       "!#$%&'*+-.0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ^_`"
       "abcdefghijklmnopqrstuvwxyz{|}~";
-  map<string, string>::const_iterator it;
-  it = headers.find("content-type");
-  if(it == headers.end())
+  if(!present(h_content_type))
     return "unknown";
-  const string &ct = it->second;
+  const string &ct = values[h_content_type];
   string::size_type pos = ct.find("charset"), end;
   if(pos == string::npos)
     return "unknown";
@@ -21,35 +21,34 @@
 #ifndef ARTICLE_H
 #define ARTICLE_H
 
-#include <map>
 #include <string>
 #include <vector>
 #include <cassert>
 
 class Article {
 public:
+  Article();
   Article(const std::string &text, size_t bytes_);
 
-  void get_groups(std::vector<std::string> &groups) const;
+  // Parse the LEN bytes at TEXT, replacing any previous contents.  Only the
+  // headers need be present.  The storage for header values is reused from
+  // one article to the next, so that scanning a spool doesn't keep going back
+  // to the allocator.
+  void parse(const char *text, size_t len, size_t bytes_);
+
+  // Fill the start of GROUPS with the article's newsgroups and return how many
+  // there are.  Any further entries are left alone so their storage can be
+  // reused.
+  size_t get_groups(std::vector<std::string> &groups) const;
   time_t date() const;
 
   inline bool valid() const {
-    auto it = headers.find("message-id");
-    if(it == headers.end())
-      return false;
-    it = headers.find("date");
-    if(it == headers.end())
-      return false;
-    it = headers.find("from");
-    if(it == headers.end())
-      return false;
-    return true;
+    return present(h_message_id) && present(h_date) && present(h_from);
   }
 
   inline const std::string &mid() const {
-    auto it = headers.find("message-id");
-    assert(it != headers.end());
-    return it->second;
+    assert(present(h_message_id));
+    return values[h_message_id];
   }
 
   inline size_t get_size() const {
@@ -57,21 +56,49 @@ public:
   }
 
   inline const std::string &sender() const {
-    auto it = headers.find("from");
-    assert(it != headers.end());
-    return it->second;
+    assert(present(h_from));
+    return values[h_from];
+  }
+
+  // The References header, or "" if there isn't one
+  inline const std::string &references() const {
+    static const std::string none;
+    return present(h_references) ? values[h_references] : none;
   }
 
   const std::string &useragent() const;
   const std::string charset() const;
 
 private:
-  void parse(const std::string &text);
-  static int eol(const std::string &text, std::string::size_type pos);
-  static int eoh(const std::string &text, std::string::size_type pos);
+  // The headers we care about
+  enum Header {
+    h_message_id,
+    h_date,
+    h_from,
+    h_newsgroups,
+    h_user_agent,
+    h_x_newsreader,
+    h_x_mailer,
+    h_content_type,
+    h_references,
+    h_count
+  };
+  struct HeaderName {
+    const char *name;
+    size_t len;
+  };
+  static const HeaderName header_names[h_count];
+
+  inline bool present(Header h) const {
+    return found & (1u << h);
+  }
+
+  static int lookup(const char *name, size_t len);
+  static int eol(const char *text, size_t len, size_t pos);
 
   size_t bytes;
-  std::map<std::string, std::string> headers;
+  unsigned found; // bitmap of headers present
+  std::string values[h_count];
   mutable time_t cached_date;
 };
 
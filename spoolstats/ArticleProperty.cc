@@ -17,6 +17,7 @@
  * USA
  */
 #include "spoolstats.h"
+#include <cmath>
 
 using namespace std;
 
@@ -25,13 +26,16 @@ ArticleProperty::ArticleProperty() {}
 ArticleProperty::~ArticleProperty() {}
 
 void ArticleProperty::update(const Article *article, const string &value) {
-  const string &sender = article->sender();
-  map<string, PropertyValue>::iterator it = values.find(value);
+  PropertyValue &v = this->value(value);
+  ++v.articles;
+  v.addSender(article->sender());
+}
+
+ArticleProperty::PropertyValue &ArticleProperty::value(const string &v) {
+  map<string, PropertyValue>::iterator it = values.find(v);
   if(it == values.end())
-    it = values.insert(pair<string, PropertyValue>(value, PropertyValue(value)))
-             .first;
-  ++it->second.articles;
-  it->second.addSender(sender);
+    it = values.insert(pair<string, PropertyValue>(v, PropertyValue(v))).first;
+  return it->second;
 }
 
 void ArticleProperty::summarize(ArticleProperty &dest,
@@ -58,13 +62,26 @@ void ArticleProperty::order(std::vector<const PropertyValue *> &ordered) const {
 ArticleProperty::PropertyValue &
 ArticleProperty::PropertyValue::operator+=(const PropertyValue &that) {
   articles += that.articles;
-  for(set<string>::const_iterator it = that.senders.begin();
+  for(map<string, int>::const_iterator it = that.senders.begin();
       it != that.senders.end(); ++it)
-    senders.insert(*it);
+    senders[it->first] += it->second;
   senderCount += that.senderCount;
+  articles_error = sqrt(articles_error * articles_error
+                        + that.articles_error * that.articles_error);
+  senders_error += that.senders_error;
   return *this;
 }
 
+void ArticleProperty::estimate(double p) {
+  for(map<string, PropertyValue>::iterator it = values.begin();
+      it != values.end(); ++it) {
+    PropertyValue &v = it->second;
+    v.articles_error = count_error(v.articles, p);
+    v.articles = llround(v.articles / p);
+    estimate_distinct(v.senders, p, v.senderCount, v.senders_error);
+  }
+}
+
 void ArticleProperty::logs(const string &path) {
   try {
     ofstream os(path.c_str(), ios::trunc);
@@ -72,8 +89,11 @@ void ArticleProperty::logs(const string &path) {
     for(map<string, PropertyValue>::const_iterator it = values.begin();
         it != values.end(); ++it) {
       const PropertyValue &v = it->second;
-      os << csv_quote(v.value) << ',' << v.articles << ',' << v.senderCount
-         << '\n';
+      os << csv_quote(v.value) << ',' << v.articles << ',' << v.senderCount;
+      if(Config::sample)
+        os << ',' << llround(v.articles_error) << ','
+           << llround(v.senders_error);
+      os << '\n';
     }
     os << flush;
   } catch(ios::failure &) {
@@ -89,6 +109,10 @@ void ArticleProperty::readLogs(const string &path) {
     PropertyValue v(row[0]);
     v.articles = row[1];
     v.senderCount = row[2];
+    if(row.size() > 4) {
+      v.articles_error = (intmax_t)row[3];
+      v.senders_error = (intmax_t)row[4];
+    }
     values.insert(pair<string, PropertyValue>(row[0], v));
   }
 }
@@ -33,12 +33,14 @@ public:
   struct PropertyValue {
     const std::string value;
     long articles;
-    std::set<std::string> senders;
+    std::map<std::string, int> senders; // sender -> article count
     size_t senderCount;
+    double articles_error, senders_error; // for --sample
     inline PropertyValue(const std::string &value_):
-        value(value_), articles(0), senderCount(0) {}
+        value(value_), articles(0), senderCount(0), articles_error(0),
+        senders_error(0) {}
     void addSender(const std::string &s) {
-      senders.insert(s);
+      ++senders[s];
       senderCount = senders.size();
     }
     PropertyValue &operator+=(const PropertyValue &that);
@@ -57,6 +59,12 @@ public:
 
   void update(const Article *article, const std::string &value);
 
+  // Find (or create) the entry for VALUE
+  PropertyValue &value(const std::string &v);
+
+  // Scale up counts from a sample taken with probability P
+  void estimate(double p);
+
   void logs(const std::string &path);
   void readLogs(const std::string &path);
 
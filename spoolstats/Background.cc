@@ -0,0 +1,138 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+
+#ifndef O_NOATIME
+#define O_NOATIME 0
+#endif
+
+namespace {
+
+// A pair of token buckets, limiting files and bytes per second.  Each is
+// implemented as the time at which the next read is allowed, which is
+// advanced by the cost of each read, but never allowed to fall more than a
+// second behind the present (which bounds the size of a burst).
+class Throttle {
+public:
+  void account(size_t bytes) {
+    if(!Config::files_per_second && !Config::bytes_per_second)
+      return;
+    chrono::steady_clock::time_point until;
+    {
+      lock_guard<mutex> guard(lock);
+      const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+      if(Config::files_per_second)
+        advance(files_next, now, 1.0 / Config::files_per_second);
+      if(Config::bytes_per_second)
+        advance(bytes_next, now, (double)bytes / Config::bytes_per_second);
+      until = max(files_next, bytes_next);
+      if(until <= now)
+        return;
+      waited += until - now;
+    }
+    this_thread::sleep_until(until);
+  }
+
+  double total() {
+    lock_guard<mutex> guard(lock);
+    return chrono::duration<double>(waited).count();
+  }
+
+private:
+  static void advance(chrono::steady_clock::time_point &next,
+                      chrono::steady_clock::time_point now, double seconds) {
+    next = max(next, now - chrono::seconds(1));
+    next += chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(seconds));
+  }
+
+  mutex lock;
+  chrono::steady_clock::time_point files_next, bytes_next;
+  chrono::steady_clock::duration waited = chrono::steady_clock::duration(0);
+};
+
+Throttle throttle;
+
+// O_NOATIME is only allowed to the file's owner
+atomic<bool> noatime(true);
+
+} // namespace
+
+void background() {
+#if defined SYS_ioprio_set
+  // From linux/ioprio.h, which isn't always installed
+  const int ioprio_who_process = 1, ioprio_class_idle = 3,
+            ioprio_class_shift = 13;
+  if(syscall(SYS_ioprio_set, ioprio_who_process, 0,
+             ioprio_class_idle << ioprio_class_shift)
+     < 0)
+    fatal(errno, "ioprio_set");
+#endif
+}
+
+int open_article(const string &path) {
+  int fd;
+  if(Config::background && noatime) {
+    if((fd = open(path.c_str(), O_RDONLY | O_NOATIME)) >= 0 || errno != EPERM)
+      return fd;
+    noatime = false;
+  }
+  return open(path.c_str(), O_RDONLY);
+}
+
+ssize_t read_article(int fd, void *buffer, size_t n, bool *cold) {
+  if(cold)
+    *cold = false;
+#if HAVE_PREADV2 && defined RWF_NOWAIT
+  if(cold && Config::background) {
+    // See if the article can be read without going to disk
+    struct iovec iov = {buffer, n};
+    const ssize_t bytes = preadv2(fd, &iov, 1, -1, RWF_NOWAIT);
+    if(bytes >= 0 || (errno != EAGAIN && errno != EOPNOTSUPP))
+      return bytes;
+    *cold = true;
+  }
+#else
+  if(cold)
+    *cold = Config::background;
+#endif
+  return read(fd, buffer, n);
+}
+
+void close_article(int fd, size_t bytes, bool cold) {
+  // Don't leave articles that no-one else wanted cluttering up the cache
+  if(cold)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+  throttle.account(bytes);
+}
+
+double throttled() {
+  return throttle.total();
+}
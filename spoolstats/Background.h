@@ -0,0 +1,46 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+// Support for --background and the rate limits.  All of these may be called
+// from any thread.
+
+// Lower the I/O priority of this process (and any threads it creates later)
+void background();
+
+// Open an article for reading
+int open_article(const std::string &path);
+
+// Read from an article.  If COLD is not NULL, set *COLD according to whether
+// the data had to come from disk rather than the page cache.  This is only
+// checked in --background mode (and otherwise *COLD is false).
+ssize_t read_article(int fd, void *buffer, size_t n, bool *cold);
+
+// Finished reading an article, having read BYTES bytes.  If it was read from
+// disk in --background mode, it is dropped from the page cache.  If a rate
+// limit applies, waits until the next article may be read.
+void close_article(int fd, size_t bytes, bool cold);
+
+// Total time spent waiting for the rate limits, in seconds
+double throttled();
+
+#endif /* BACKGROUND_H */
@@ -18,11 +18,19 @@
  * USA
  */
 #include "spoolstats.h"
+#include <cmath>
 
 using namespace std;
 
 Bucket::~Bucket() {}
 
+void Bucket::estimate(double p) {
+  articles_error = count_error(articles, p);
+  bytes_error = sum_error(bytes_squared, p);
+  articles = llround(articles / p);
+  bytes = llround(bytes / p);
+}
+
 void Bucket::verticalScale(double max, double &limit, double &chunk,
                            double &count) {
   for(chunk = 1; 10 * chunk < max; chunk *= 10)
@@ -32,7 +40,8 @@ void Bucket::verticalScale(double max, double &limit, double &chunk,
   limit = chunk * count;
 }
 
-void Bucket::graph(const string &title, const string &csv, const string &png) {
+void Bucket::graph(const string &title, const string &csv, const string &png,
+                   size_t error_column) {
   vector<vector<Value>> rows;
   read_csv(csv, rows);
   TimeGraph g(720, 480, gmtime_r, timegm);
@@ -46,6 +55,11 @@ void Bucket::graph(const string &title, const string &csv, const string &png) {
     intmax_t articlecount = (*it)[3];
     double byterate = bytecount / (seconds / 86400);
     double articlerate = articlecount / (seconds / 86400);
+    // Leave room for error bars
+    if(it->size() > error_column + 1) {
+      byterate += (double)(*it)[error_column] / (seconds / 86400);
+      articlerate += (double)(*it)[error_column + 1] / (seconds / 86400);
+    }
     if(byterate > maxbyterate)
       maxbyterate = byterate;
     if(articlerate > maxarticlerate)
@@ -68,6 +82,19 @@ void Bucket::graph(const string &title, const string &csv, const string &png) {
     g.marker_y(1, y, compact_kilo(y));
   }
   g.axes();
+  // Error bars for sampled rows
+  for(vector<vector<Value>>::iterator it = rows.begin(); it != rows.end();
+      ++it) {
+    if(it->size() <= error_column + 1)
+      continue;
+    double x = (*it)[0];
+    intmax_t seconds = (*it)[1];
+    for(int v = 0; v < 2; ++v) {
+      double rate = (double)(*it)[2 + v] / (seconds / 86400);
+      double error = (double)(*it)[error_column + v] / (seconds / 86400);
+      g.error_bar(v, x, max(rate - error, 0.0), rate + error);
+    }
+  }
   for(vector<vector<Value>>::iterator it = rows.begin(); it != rows.end();
       ++it) {
     double x = (*it)[0];
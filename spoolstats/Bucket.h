@@ -28,18 +28,36 @@ public:
   int articles;   // count of articles
   intmax_t bytes; // count of bytes
 
-  inline Bucket(): articles(0), bytes(0) {}
+  // For --sample: sum of the squares of the article sizes, and the errors in
+  // the estimated counts
+  double bytes_squared;
+  double articles_error, bytes_error;
+
+  inline Bucket():
+      articles(0), bytes(0), bytes_squared(0), articles_error(0),
+      bytes_error(0) {}
 
   virtual ~Bucket();
 
+  // Scale up counts from a sample taken with probability P
+  virtual void estimate(double p);
+
   // Supply an article to this bucket
   inline void visit(const Article *a) {
+    credit(a->get_size());
+  }
+
+  // Count one article of SIZE bytes
+  inline void credit(intmax_t size) {
     ++articles;
-    bytes += a->get_size();
+    bytes += size;
+    bytes_squared += (double)size * size;
   }
 
+  // Graph the history in CSV.  If there are error estimates then they start
+  // at column ERROR_COLUMN.
   void graph(const std::string &title, const std::string &csv,
-             const std::string &png);
+             const std::string &png, size_t error_column);
 
 private:
   void verticalScale(double max, double &limit, double &chunk, double &count);
@@ -21,10 +21,13 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <cstdlib>
+#include <algorithm>
+#include <sys/stat.h>
 
 using namespace std;
 
 bool Config::terminal;
+bool Config::quiet;
 time_t Config::start_time;
 time_t Config::end_time;
 time_t Config::start_mtime;
@@ -34,11 +37,81 @@ string Config::output = ".";
 int Config::days = 7;
 string Config::spool = "/var/spool/news/articles";
 string Config::user;
+size_t Config::max_memory;
+string Config::spill_dir;
+unsigned Config::shard;
+unsigned Config::shards = 1;
+string Config::emit_partial;
+vector<string> Config::partials;
+vector<int> Config::windows;
+bool Config::stream;
+unsigned Config::jobs = 1;
+int Config::read_order = read_order_directory;
+bool Config::background;
+double Config::files_per_second;
+double Config::bytes_per_second;
+double Config::sample;
+string Config::checkpoint;
+int Config::checkpoint_interval = 600;
+bool Config::resume;
+vector<string> Config::analyses;
+int Config::followups_min = 5;
+int Config::followups_age;
+string Config::active;
+bool Config::liveness;
+bool Config::liveness_by_age;
+string Config::top_output;
+
+// Parse a size with an optional K, M or G suffix
+static size_t parse_size(const char *s) {
+  char *end;
+  errno = 0;
+  unsigned long long n = strtoull(s, &end, 10);
+  if(errno || end == s)
+    fatal(0, "invalid size '%s'", s);
+  switch(*end) {
+  case 'k':
+  case 'K': n <<= 10; ++end; break;
+  case 'm':
+  case 'M': n <<= 20; ++end; break;
+  case 'g':
+  case 'G': n <<= 30; ++end; break;
+  }
+  if(*end)
+    fatal(0, "invalid size '%s'", s);
+  return n;
+}
 
 // Parse command line options
 void Config::Options(int argc, char **argv) {
   int n;
-  enum { opt_scan = 256, opt_no_scan, opt_graph, opt_no_graph };
+  enum {
+    opt_scan = 256,
+    opt_no_scan,
+    opt_graph,
+    opt_no_graph,
+    opt_max_memory,
+    opt_spill_dir,
+    opt_shard,
+    opt_emit_partial,
+    opt_merge,
+    opt_stream,
+    opt_jobs,
+    opt_read_order,
+    opt_background,
+    opt_files_per_second,
+    opt_bytes_per_second,
+    opt_sample,
+    opt_checkpoint,
+    opt_checkpoint_interval,
+    opt_resume,
+    opt_analyze,
+    opt_followups_min,
+    opt_followups_age,
+    opt_active,
+    opt_liveness
+  };
+  bool merge = false;
 
   // The option table
   static const struct option options[] = {
@@ -53,6 +126,26 @@ void Config::Options(int argc, char **argv) {
       {"no-scan", no_argument, 0, opt_no_scan},
       {"graph", no_argument, 0, opt_graph},
       {"no-graph", no_argument, 0, opt_no_graph},
+      {"max-memory", required_argument, 0, opt_max_memory},
+      {"spill-dir", required_argument, 0, opt_spill_dir},
+      {"shard", required_argument, 0, opt_shard},
+      {"emit-partial", required_argument, 0, opt_emit_partial},
+      {"merge", no_argument, 0, opt_merge},
+      {"stream", no_argument, 0, opt_stream},
+      {"jobs", required_argument, 0, opt_jobs},
+      {"read-order", required_argument, 0, opt_read_order},
+      {"background", no_argument, 0, opt_background},
+      {"files-per-second", required_argument, 0, opt_files_per_second},
+      {"bytes-per-second", required_argument, 0, opt_bytes_per_second},
+      {"sample", required_argument, 0, opt_sample},
+      {"checkpoint", required_argument, 0, opt_checkpoint},
+      {"checkpoint-interval", required_argument, 0, opt_checkpoint_interval},
+      {"resume", no_argument, 0, opt_resume},
+      {"analyze", required_argument, 0, opt_analyze},
+      {"followups-min", required_argument, 0, opt_followups_min},
+      {"followups-age", required_argument, 0, opt_followups_age},
+      {"active", required_argument, 0, opt_active},
+      {"liveness", optional_argument, 0, opt_liveness},
       {"help", no_argument, 0, 'h'},
       {"quiet", no_argument, 0, 'Q'},
       {"user", required_argument, 0, 'u'},
@@ -64,7 +157,10 @@ void Config::Options(int argc, char **argv) {
     switch(n) {
     case 'D': debug = 1; break;
     case 'S': spool = optarg; break;
-    case 'Q': terminal = false; break;
+    case 'Q':
+      terminal = false;
+      quiet = true;
+      break;
     case 'H': {
       vector<string> bits;
       split(bits, ',', string(optarg));
@@ -91,23 +187,103 @@ void Config::Options(int argc, char **argv) {
       hierarchy("rec");
       hierarchy("talk");
       break;
-    case 'N':
-      days = atoi(optarg);
-      if(days <= 0)
-        fatal(0, "--days must be positive");
+    case 'N': {
+      vector<string> bits;
+      split(bits, ',', string(optarg));
+      windows.clear();
+      for(size_t i = 0; i < bits.size(); ++i) {
+        days = atoi(bits[i].c_str());
+        if(days <= 0)
+          fatal(0, "--days must be positive");
+        windows.push_back(days);
+      }
       break;
+    }
     case 'O': output = optarg; break;
     case 'u': user = optarg; break;
     case opt_scan: scan = true; break;
     case opt_no_scan: scan = false; break;
     case opt_graph: graph = true; break;
     case opt_no_graph: graph = false; break;
+    case opt_max_memory:
+      max_memory = parse_size(optarg);
+      if(!max_memory)
+        fatal(0, "--max-memory must be positive");
+      break;
+    case opt_spill_dir: spill_dir = optarg; break;
+    case opt_shard: {
+      vector<string> bits;
+      split(bits, '/', string(optarg));
+      if(bits.size() != 2)
+        fatal(0, "invalid argument to --shard option");
+      shard = atoi(bits[0].c_str());
+      shards = atoi(bits[1].c_str());
+      if(shards < 1 || shard >= shards)
+        fatal(0, "invalid argument to --shard option");
+      break;
+    }
+    case opt_emit_partial: emit_partial = optarg; break;
+    case opt_merge: merge = true; break;
+    case opt_stream: stream = true; break;
+    case opt_jobs:
+      if(atoi(optarg) < 1)
+        fatal(0, "invalid argument to --jobs option");
+      jobs = atoi(optarg);
+      break;
+    case opt_read_order:
+      if((read_order = parse_read_order(optarg)) < 0)
+        fatal(0, "invalid argument to --read-order option");
+      break;
+    case opt_background: background = true; break;
+    case opt_files_per_second:
+      if((files_per_second = atof(optarg)) <= 0)
+        fatal(0, "invalid argument to --files-per-second option");
+      break;
+    case opt_bytes_per_second:
+      if(!(bytes_per_second = parse_size(optarg)))
+        fatal(0, "invalid argument to --bytes-per-second option");
+      break;
+    case opt_sample:
+      sample = atof(optarg);
+      if(sample <= 0 || sample > 1)
+        fatal(0, "invalid argument to --sample option");
+      break;
+    case opt_checkpoint: checkpoint = optarg; break;
+    case opt_checkpoint_interval:
+      if((checkpoint_interval = atoi(optarg)) < 0)
+        fatal(0, "invalid argument to --checkpoint-interval option");
+      break;
+    case opt_resume: resume = true; break;
+    case opt_followups_min: followups_min = atoi(optarg); break;
+    case opt_followups_age: followups_age = atoi(optarg); break;
+    case opt_active: active = optarg; break;
+    case opt_liveness:
+      liveness = true;
+      if(!optarg || !strcmp(optarg, "traffic"))
+        liveness_by_age = false;
+      else if(!strcmp(optarg, "age"))
+        liveness_by_age = true;
+      else
+        fatal(0, "invalid argument to --liveness option");
+      break;
+    case opt_analyze: {
+      vector<string> bits;
+      split(bits, ',', string(optarg));
+      for(size_t i = 0; i < bits.size(); ++i) {
+        Analyzer *a = Analyzer::find(bits[i]);
+        if(!a)
+          fatal(0, "unknown analysis '%s'", bits[i].c_str());
+        delete a;
+        analyses.push_back(bits[i]);
+      }
+      break;
+    }
     case 'h':
       printf("Usage:\n\
   spoolstats [OPTIONS]\n\
 \n\
 Options:\n\
-  -N, --days DAYS                   Number of days to analyse\n\
+  -N, --days DAYS[,DAYS...]         Number of days to analyse\n\
   -L, --latency BEFORE, AFTER       Set latencies in seconds\n\
   -S, --spool PATH                  Path to spool\n\
   -H, --hierarchies NAME[,NAME...]  Hierarchies to analyse\n\
@@ -116,6 +292,28 @@ Options:\n\
   -u, --user USER                   User to run as\n\
   -Q, --quiet                       Quieter operation\n\
   --no-scan, --no-graph             Suppress phases\n\
+  --max-memory SIZE                 Bound memory use, spilling to disk\n\
+  --spill-dir DIRECTORY             Directory for --max-memory spill files\n\
+  --shard I/N                       Scan only shard I of N (from 0)\n\
+  --emit-partial PATH               Write partial results instead of logs\n\
+  --merge PATH...                   Combine partial results\n\
+  --stream                          Report each hierarchy as it is done\n\
+  --jobs N                          Threads for reading large directories\n\
+  --read-order directory|inode|physical\n\
+                                    Order to read articles in\n\
+  --background                      Give way to other disk users\n\
+  --files-per-second N              Limit articles read per second\n\
+  --bytes-per-second SIZE           Limit bytes read per second\n\
+  --sample RATE                     Estimate from a fraction of the articles\n\
+  --checkpoint PATH                 Save scan progress to PATH\n\
+  --checkpoint-interval SECONDS     How often to save it (default 600)\n\
+  --resume                          Continue from the checkpoint\n\
+  --analyze NAME[,NAME...]          Extra analyses (references, followups,\n\
+                                    liveness)\n\
+  --followups-min N                 Fewest follow-ups to graph (default 5)\n\
+  --followups-age DAYS              Only graph recent follow-ups\n\
+  --liveness[=traffic|age]          Just report group liveness, quickly\n\
+  --active PATH                     Path to INN active file\n\
   -h, --help                        Display usage message\n\
   -V, --version                     Display version number\n");
       exit(0);
@@ -125,18 +323,96 @@ Options:\n\
     default: exit(1);
     }
   }
+  if(merge) {
+    if(optind >= argc)
+      fatal(0, "--merge requires at least one partial");
+    if(!scan || shards > 1)
+      fatal(0, "--merge cannot be used with --no-scan or --shard");
+    partials.assign(argv + optind, argv + argc);
+  }
+  if(emit_partial.size() && !scan)
+    fatal(0, "--emit-partial cannot be used with --no-scan");
+  // The scan covers the longest window
+  if(windows.empty())
+    windows.push_back(days);
+  sort(windows.begin(), windows.end(), greater<int>());
+  windows.erase(unique(windows.begin(), windows.end()), windows.end());
+  days = windows[0];
+  if(windows.size() > 1
+     && (max_memory || emit_partial.size() || partials.size()))
+    fatal(0, "--days with several values cannot be used with --max-memory, "
+             "--emit-partial or --merge");
+  if(stream
+     && (windows.size() > 1 || !scan || max_memory || emit_partial.size()
+         || partials.size()))
+    fatal(0, "--stream cannot be used with several --days values, --no-scan, "
+             "--max-memory, --emit-partial or --merge");
+  if(analyses.size()
+     && (!scan || max_memory || emit_partial.size() || partials.size()))
+    fatal(0, "--analyze cannot be used with --no-scan, --max-memory, "
+             "--emit-partial or --merge");
+  if(sample
+     && (!scan || stream || max_memory || emit_partial.size()
+         || partials.size() || analyses.size()))
+    fatal(0, "--sample cannot be used with --no-scan, --stream, --max-memory, "
+             "--emit-partial, --merge or --analyze");
+  if(resume && checkpoint.empty())
+    fatal(0, "--resume requires --checkpoint");
+  if(checkpoint.size()
+     && (windows.size() > 1 || !scan || stream || partials.size()
+         || analyses.size() || sample))
+    fatal(0, "--checkpoint cannot be used with several --days values, "
+             "--no-scan, --stream, --merge, --analyze or --sample");
+  top_output = output;
+  if(spill_dir.empty()) {
+    const char *tmpdir = getenv("TMPDIR");
+    spill_dir = tmpdir && *tmpdir ? tmpdir : "/tmp";
+  }
   time(&end_time);
-  end_time -= end_latency;
+  // Liveness is reported as of now, not as of the end of a sampling interval
+  if(!liveness)
+    end_time -= end_latency;
   start_time = end_time - 86400 * days;
   start_mtime = start_time - start_latency;
 }
 
+// Make window N current.  With several windows each has its own
+// subdirectory of the output directory.
+void Config::select(size_t n) {
+  if(windows.size() == 1)
+    return;
+  days = windows[n];
+  start_time = end_time - 86400 * days;
+  output = top_output + "/" + to_string(days);
+  if(mkdir(output.c_str(), 0777) < 0 && errno != EEXIST)
+    fatal(errno, "creating %s", output.c_str());
+}
+
 // Add a hierarchy
 void Config::hierarchy(const string &h) {
   if(hierarchies.find(h) == hierarchies.end())
     hierarchies[h] = new Hierarchy(h);
 }
 
+// Return true if articles in DIR are in this shard.  Shards are assigned by
+// the path below the spool, so that they are the same on every machine.
+bool Config::in_shard(const string &dir) {
+  if(shards == 1)
+    return true;
+  const size_t skip = dir.size() > spool.size() ? spool.size() + 1 : 0;
+  return hash64(dir.data() + skip, dir.size() - skip) % shards == shard;
+}
+
+bool Config::sampled(ino_t ino) {
+  if(!sample || sample >= 1)
+    return true;
+  // Crossposted articles are hard links, so share an inode and are sampled
+  // (or not) together, without needing to be opened.  Where they are
+  // symlinks the callers pass the inode of the target.
+  return hash64(reinterpret_cast<const char *>(&ino), sizeof ino)
+         < sample * 18446744073709551616.0;
+}
+
 void Config::footer(ostream &os) {
   os << "<p><a href=" << HTML::Quote(".") << ">Hierarchies</a>"
      << " | <a href=" << HTML::Quote("allgroups.html") << ">All groups</a>"
@@ -23,6 +23,7 @@
 
 struct Config {
   static bool terminal;
+  static bool quiet;
   static time_t start_time;
   static time_t end_time;
   static time_t start_mtime;
@@ -34,6 +35,28 @@ struct Config {
   static bool scan;
   static bool graph;
   static std::string user;
+  static size_t max_memory;
+  static std::string spill_dir;
+  static unsigned shard;
+  static unsigned shards;
+  static std::string emit_partial;
+  static std::vector<std::string> partials;
+  static bool stream;
+  static unsigned jobs;
+  static int read_order;
+  static bool background;
+  static double files_per_second;
+  static double bytes_per_second;
+  static double sample;
+  static std::string checkpoint;
+  static int checkpoint_interval;
+  static bool resume;
+  static std::vector<std::string> analyses;
+  static int followups_min;
+  static int followups_age;
+  static std::string active;
+  static bool liveness;
+  static bool liveness_by_age;
 
   // Parse command line
   static void Options(int argc, char **argv);
@@ -44,9 +67,25 @@ struct Config {
   // Generate standard footer
   static void footer(std::ostream &os);
 
+  // Return true if articles in DIR are in this shard
+  static bool in_shard(const std::string &dir);
+
+  // Return true if the article with inode INO is in the sample
+  static bool sampled(ino_t ino);
+
+  // Reporting windows in days, longest first.  days, start_time and output
+  // describe the current window.
+  static std::vector<int> windows;
+
+  // Make window N current
+  static void select(size_t n);
+
 private:
   // Add a hierarchy
   static void hierarchy(const std::string &h);
+
+  // Output directory before any per-window subdirectory is added
+  static std::string top_output;
 };
 
 #endif /* CONF_H */
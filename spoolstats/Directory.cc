@@ -0,0 +1,110 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+
+using namespace std;
+
+#if defined SYS_getdents64
+
+// The kernel's directory entry format (see getdents64(2))
+struct linux_dirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+void read_directory(int fd, const string &path,
+                    vector<DirectoryEntry> &entries) {
+  vector<char> buffer(1024 * 1024);
+  DirectoryEntry e;
+  long n;
+  while((n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size())) > 0) {
+    for(long pos = 0; pos < n;) {
+      const linux_dirent64 *d =
+          reinterpret_cast<const linux_dirent64 *>(&buffer[pos]);
+      pos += d->d_reclen;
+      if(d->d_name[0] == '.'
+         && (!d->d_name[1] || (d->d_name[1] == '.' && !d->d_name[2])))
+        continue;
+      e.name = d->d_name;
+      e.ino = d->d_ino;
+      e.type = d->d_type;
+      entries.push_back(e);
+    }
+  }
+  if(n < 0)
+    fatal(errno, "reading %s", path.c_str());
+}
+
+#else
+
+void read_directory(int fd, const string &path,
+                    vector<DirectoryEntry> &entries) {
+  DIR *dp;
+  struct dirent *de;
+  DirectoryEntry e;
+  // fdopendir() takes ownership of its argument
+  if((fd = dup(fd)) < 0)
+    fatal(errno, "dup");
+  if(!(dp = fdopendir(fd)))
+    fatal(errno, "opening %s", path.c_str());
+  errno = 0;
+  while((de = readdir(dp))) {
+    if(strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+      e.name = de->d_name;
+      e.ino = de->d_ino;
+      e.type = de->d_type;
+      entries.push_back(e);
+    }
+    errno = 0; // stupid readdir() API
+  }
+  if(errno)
+    fatal(errno, "reading %s", path.c_str());
+  closedir(dp);
+}
+
+#endif
+
+void schedule(int fd, vector<const DirectoryEntry *> &entries) {
+  if(Config::read_order == read_order_directory)
+    return;
+  // On a rotating disk, reading in inode or physical block order rather
+  // than directory order avoids a seek per article
+  vector<pair<uint64_t, const DirectoryEntry *>> keyed;
+  for(size_t n = 0; n < entries.size(); ++n)
+    keyed.push_back(make_pair(
+        read_order_key(Config::read_order, fd, entries[n]->name.c_str(),
+                       entries[n]->ino),
+        entries[n]));
+  stable_sort(keyed.begin(), keyed.end(),
+              [](const pair<uint64_t, const DirectoryEntry *> &a,
+                 const pair<uint64_t, const DirectoryEntry *> &b) {
+                return a.first < b.first;
+              });
+  for(size_t n = 0; n < entries.size(); ++n)
+    entries[n] = keyed[n].second;
+}
@@ -0,0 +1,275 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <sys/stat.h>
+#include <cctype>
+#include <cmath>
+
+using namespace std;
+
+// Who follows up to whom.  For each group (and hierarchy) a graph is written
+// in Graphviz format, with an edge from each poster to each poster they
+// follow up to at least Config::followups_min times.
+
+namespace {
+
+// One article.  Message IDs are hashed and senders interned, so each article
+// costs a couple of dozen bytes regardless of how long its headers are.
+struct Followup {
+  uint64_t mid;    // hash of Message-ID
+  uint64_t parent; // hash of parent's Message-ID, or 0
+  uint32_t sender; // interned poster address
+
+  bool operator<(const Followup &that) const {
+    return mid < that.mid;
+  }
+};
+
+struct FollowupState: public Analyzer::State {
+  FollowupAnalyzer *analyzer;
+  std::vector<Followup> articles;
+
+  FollowupState(FollowupAnalyzer *a): analyzer(a) {}
+
+  void visit(const Article *a);
+
+  void merge(const State &that_) {
+    const FollowupState &that = static_cast<const FollowupState &>(that_);
+    articles.insert(articles.end(), that.articles.begin(),
+                    that.articles.end());
+  }
+};
+
+// Strip leading and trailing whitespace
+string trim(const string &s) {
+  const string::size_type begin = s.find_first_not_of(" \t\r\n");
+  if(begin == string::npos)
+    return "";
+  return s.substr(begin, s.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+// Split a From: field into address and display name, heuristically
+void parse_from(const string &from, string &address, string &name) {
+  const string::size_type lt = from.find('<');
+  const string::size_type gt = lt == string::npos ? lt : from.find('>', lt);
+  if(gt != string::npos && gt > lt + 1) {
+    // Name <address> or <address> (name)
+    address.assign(from, lt + 1, gt - lt - 1);
+    const string before = trim(from.substr(0, lt));
+    const string after = trim(from.substr(gt + 1));
+    name = before.size() > after.size() ? before : after;
+    return;
+  }
+  // address (name)
+  const string::size_type at = from.find('@');
+  if(at == string::npos) {
+    address = trim(from);
+    name.clear();
+    return;
+  }
+  string::size_type begin = from.find_last_of(" \t", at);
+  begin = begin == string::npos ? 0 : begin + 1;
+  const string::size_type end = from.find_first_of(" \t", at);
+  address.assign(from, begin, end == string::npos ? end : end - begin);
+  const string::size_type open = from.find('(');
+  const string::size_type close = from.rfind(')');
+  if(open != string::npos && close != string::npos && close > open)
+    name.assign(from, open + 1, close - open - 1);
+  else
+    name.clear();
+}
+
+// The parent of an article is the last entry in References
+string last_reference(const string &references) {
+  const string::size_type gt = references.rfind('>');
+  if(gt == string::npos)
+    return "";
+  const string::size_type lt = references.rfind('<', gt);
+  if(lt == string::npos)
+    return "";
+  return references.substr(lt, gt - lt + 1);
+}
+
+void FollowupState::visit(const Article *a) {
+  if(Config::followups_age
+     && a->date() < Config::end_time - 86400 * Config::followups_age)
+    return;
+  Followup f;
+  f.mid = hash64(a->mid());
+  const string p = last_reference(a->references());
+  f.parent = p.size() ? hash64(p) : 0;
+  f.sender = analyzer->sender(a->sender());
+  articles.push_back(f);
+}
+
+// Escape a string for use inside a Graphviz quoted string
+string dot_escape(const string &s) {
+  string q;
+  for(size_t n = 0; n < s.size(); ++n) {
+    if(s[n] == '"' || s[n] == '\\')
+      q += '\\';
+    q += s[n];
+  }
+  return q;
+}
+
+// Write the graph for S to PATH.  S is sorted and deduplicated in place.
+void graph(const string &path, const FollowupAnalyzer *analyzer,
+           FollowupState *s) {
+  // Sort by message ID, dropping duplicates (from crossposts)
+  vector<Followup> &articles = s->articles;
+  sort(articles.begin(), articles.end());
+  articles.erase(unique(articles.begin(), articles.end(),
+                        [](const Followup &a, const Followup &b) {
+                          return a.mid == b.mid;
+                        }),
+                 articles.end());
+  // Join each follow-up's parent against the articles, giving a list of
+  // (follower, original poster) pairs
+  vector<pair<uint64_t, uint32_t>> parents; // parent -> follower
+  for(size_t n = 0; n < articles.size(); ++n)
+    if(articles[n].parent)
+      parents.push_back(
+          pair<uint64_t, uint32_t>(articles[n].parent, articles[n].sender));
+  sort(parents.begin(), parents.end());
+  vector<pair<uint32_t, uint32_t>> follows; // follower -> original poster
+  size_t m = 0;
+  for(size_t n = 0; n < parents.size(); ++n) {
+    while(m < articles.size() && articles[m].mid < parents[n].first)
+      ++m;
+    if(m < articles.size() && articles[m].mid == parents[n].first)
+      follows.push_back(
+          pair<uint32_t, uint32_t>(parents[n].second, articles[m].sender));
+  }
+  vector<pair<uint64_t, uint32_t>>().swap(parents);
+  // Count the follow-ups for each pair and find the edges worth drawing
+  sort(follows.begin(), follows.end());
+  struct Edge {
+    uint32_t from, to;
+    int weight;
+  };
+  vector<Edge> edges;
+  map<string, uint32_t> mentioned; // address -> sender, for ordering
+  int maxweight = 0;
+  for(size_t n = 0, e; n < follows.size(); n = e) {
+    for(e = n; e < follows.size() && follows[e] == follows[n]; ++e)
+      ;
+    const int weight = e - n;
+    if(weight < Config::followups_min)
+      continue;
+    const Edge edge = {follows[n].first, follows[n].second, weight};
+    edges.push_back(edge);
+    mentioned[analyzer->address(edge.from)] = edge.from;
+    mentioned[analyzer->address(edge.to)] = edge.to;
+    maxweight = max(maxweight, weight);
+  }
+  try {
+    ofstream os(path.c_str());
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    os << "digraph follows {\n";
+    for(map<string, uint32_t>::const_iterator it = mentioned.begin();
+        it != mentioned.end(); ++it) {
+      os << "  n" << it->second << " [ label=\"" << dot_escape(it->first);
+      const string &name = analyzer->name(it->second);
+      if(name.size())
+        os << "\\n" << dot_escape(name);
+      os << "\" ]\n";
+    }
+    const int min_follows = Config::followups_min;
+    for(size_t n = 0; n < edges.size(); ++n) {
+      double rating = maxweight > min_follows
+                          ? (double)(edges[n].weight - min_follows)
+                                / (maxweight - min_follows)
+                          : 1;
+      rating = sqrt(rating); // boost low values a bit
+      char color[8];
+      snprintf(color, sizeof color, "#%02x00%02x", (int)(255 * rating),
+               (int)(255 * (1 - rating)));
+      os << "  n" << edges[n].from << " -> n" << edges[n].to << " [ color=\""
+         << color << "\",label=" << edges[n].weight << ",fontcolor=\"" << color
+         << "\" ]\n";
+    }
+    os << "}\n" << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", path.c_str());
+  }
+}
+
+// Create DIR if it doesn't exist
+void make_directory(const string &dir) {
+  if(mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST)
+    fatal(errno, "creating %s", dir.c_str());
+}
+
+// Return true if NAME is a plausible newsgroup name: non-empty components of
+// letters, digits, '+', '-' and '_', separated by dots.  Group names come
+// from articles' Newsgroups headers and are used as filenames, so anything
+// else (a '/', whitespace, a leading dot) is not trusted.
+bool valid_name(const string &name) {
+  bool start = true;
+  for(size_t n = 0; n < name.size(); ++n) {
+    const char c = name[n];
+    if(c == '.') {
+      if(start)
+        return false;
+      start = true;
+    } else if(isalnum((unsigned char)c) || c == '+' || c == '-' || c == '_')
+      start = false;
+    else
+      return false;
+  }
+  return !start;
+}
+
+// Write a graph for each state in STATES that has a valid name, into DIR
+void graphs(const string &dir, const FollowupAnalyzer *analyzer,
+            const Analyzer::States &states) {
+  make_directory(dir);
+  for(Analyzer::States::const_iterator it = states.begin();
+      it != states.end(); ++it)
+    if(valid_name(it->first))
+      graph(dir + "/" + it->first + ".dot", analyzer,
+            static_cast<FollowupState *>(it->second));
+}
+
+} // namespace
+
+Analyzer::State *FollowupAnalyzer::create() const {
+  return new FollowupState(const_cast<FollowupAnalyzer *>(this));
+}
+
+uint32_t FollowupAnalyzer::sender(const string &from) {
+  parse_from(from, address_, name_);
+  const uint32_t id = senders.intern(address_);
+  if(id == names.size())
+    names.push_back(string());
+  if(name_.size())
+    names[id] = name_;
+  return id;
+}
+
+void FollowupAnalyzer::report(const States &groups, const States &hierarchies) {
+  // Groups and hierarchies go in separate directories, since a group can
+  // have the same name as a hierarchy (e.g. control)
+  const string dir = Config::output + "/followups";
+  make_directory(dir);
+  graphs(dir + "/groups", this, groups);
+  graphs(dir + "/hierarchies", this, hierarchies);
+}
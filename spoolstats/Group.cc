@@ -23,6 +23,11 @@ using namespace std;
 
 Group::Group(const string &name_): name(name_) {}
 
+Group::~Group() {
+  for(size_t n = 0; n < states.size(); ++n)
+    delete states[n];
+}
+
 // Visit one article
 void Group::visit(const Article *a) {
   Bucket::visit(a);
@@ -44,9 +49,12 @@ void Group::summary(ostream &os) {
   os << "<td>" << HTML::Escape(name) << "</td>\n";
   os << "<td sorttable_customkey=-" << fixed << arts_per_day << ">"
      << setprecision(arts_per_day >= 10 ? 0 : 1) << arts_per_day
-     << setprecision(6) << "</td>\n";
+     << setprecision(6) << plus_minus(articles_error / Config::days)
+     << "</td>\n";
   os << "<td sorttable_customkey=-" << bytes_per_day << ">"
-     << round_kilo(bytes_per_day) << "</td>\n";
-  os << "<td sorttable_customkey=-" << posters << ">" << posters << "</td>\n";
+     << round_kilo(bytes_per_day)
+     << plus_minus(bytes_error / Config::days, true) << "</td>\n";
+  os << "<td sorttable_customkey=-" << posters << ">" << posters
+     << plus_minus(senders_error) << "</td>\n";
   // TODO can we find a better stream state restoration idiom?
 }
@@ -29,6 +29,11 @@ public:
 
   Group(const std::string &name_);
 
+  ~Group();
+
+  // State for each of AllGroups::analyzers (created as needed)
+  std::vector<Analyzer::State *> states;
+
   // Visit one article
   void visit(const Article *a);
 
@@ -51,10 +51,13 @@ void Hierarchy::summary(ostream &os) {
      << HTML::Escape(name) << ".*</a></td>\n";
   os << "<td sorttable_customkey=-" << fixed << arts_per_day << ">"
      << setprecision(arts_per_day >= 10 ? 0 : 1) << arts_per_day
-     << setprecision(6) << "</td>\n";
+     << setprecision(6) << plus_minus(articles_error / Config::days)
+     << "</td>\n";
   os << "<td sorttable_customkey=-" << bytes_per_day << ">"
-     << round_kilo(bytes_per_day) << "</td>\n";
-  os << "<td sorttable_customkey=-" << posters << ">" << posters << "</td>\n";
+     << round_kilo(bytes_per_day)
+     << plus_minus(bytes_error / Config::days, true) << "</td>\n";
+  os << "<td sorttable_customkey=-" << posters << ">" << posters
+     << plus_minus(senders_error) << "</td>\n";
   os << "</tr>\n";
   // TODO can we find a better stream state restoration idiom?
 }
@@ -94,9 +97,11 @@ void Hierarchy::page() {
     os << "<tr>\n";
     os << "<td>Total</td>\n";
     os << "<td>" << setprecision(total_arts_per_day >= 10 ? 0 : 1)
-       << total_arts_per_day << setprecision(6) << "</td>\n";
-    os << "<td>" << round_kilo(total_bytes_per_day) << "</td>\n";
-    os << "<td>" << total_posters << "</td>\n";
+       << total_arts_per_day << setprecision(6)
+       << plus_minus(articles_error / Config::days) << "</td>\n";
+    os << "<td>" << round_kilo(total_bytes_per_day)
+       << plus_minus(bytes_error / Config::days, true) << "</td>\n";
+    os << "<td>" << total_posters << plus_minus(senders_error) << "</td>\n";
     os << "</tr>\n";
     os << "</tfoot>\n";
     os << "</table>\n";
@@ -114,8 +119,11 @@ void Hierarchy::logs() {
     ofstream os((Config::output + "/" + name + ".csv").c_str(), ios::app);
     os.exceptions(ofstream::badbit | ofstream::failbit);
     os << Config::end_time << ',' << Config::days * 86400 << ',' << bytes << ','
-       << articles << ',' << senderCount << '\n'
-       << flush;
+       << articles << ',' << senderCount;
+    if(Config::sample)
+      os << ',' << llround(bytes_error) << ',' << llround(articles_error) << ','
+         << llround(senders_error);
+    os << '\n' << flush;
   } catch(ios::failure &) {
     fatal(errno, "writing to %s",
           (Config::output + "/" + name + ".csv").c_str());
@@ -128,7 +136,11 @@ void Hierarchy::logs() {
         it != groups.end(); ++it) {
       const Group *g = it->second;
       os << csv_quote(it->first) << "," << g->bytes << "," << g->articles << ","
-         << g->senderCount << '\n';
+         << g->senderCount;
+      if(Config::sample)
+        os << ',' << llround(g->bytes_error) << ','
+           << llround(g->articles_error) << ',' << llround(g->senders_error);
+      os << '\n';
     }
     os << flush;
   } catch(ios::failure &) {
@@ -144,6 +156,11 @@ void Hierarchy::readLogs() {
     bytes = last[2];
     articles = last[3];
     senderCount = last[4];
+    if(last.size() > 7) {
+      bytes_error = (intmax_t)last[5];
+      articles_error = (intmax_t)last[6];
+      senders_error = (intmax_t)last[7];
+    }
   }
   rows.clear();
   const string groupdata = Config::output + "/" + name + "-groups.csv";
@@ -154,11 +171,28 @@ void Hierarchy::readLogs() {
     g->bytes = row[1];
     g->articles = row[2];
     g->senderCount = row[3];
+    if(row.size() > 6) {
+      g->bytes_error = (intmax_t)row[4];
+      g->articles_error = (intmax_t)row[5];
+      g->senders_error = (intmax_t)row[6];
+    }
     groups[row[0]] = g;
   }
 }
 
+void Hierarchy::finish() {
+  logs();
+  if(Config::graph) {
+    graphs();
+    page();
+  }
+  release();
+  for(map<string, Group *>::const_iterator it = groups.begin();
+      it != groups.end(); ++it)
+    it->second->release();
+}
+
 void Hierarchy::graphs() {
   graph(name + ".*", Config::output + "/" + name + ".csv",
-        Config::output + "/" + name + ".png");
+        Config::output + "/" + name + ".png", 5);
 }
@@ -49,6 +49,10 @@ public:
   // Generate a report page for this hiearchy
   void page();
 
+  // Generate logs, graphs and page, then release per-sender data.  Used
+  // when the hierarchy is complete before the rest of the scan is.
+  void finish();
+
   // Locate a group (which must be in this hierarchy)
   Group *group(const std::string &name);
 
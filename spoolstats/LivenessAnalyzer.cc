@@ -0,0 +1,141 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// How many articles each group has had and when the most recent one was
+// posted.  Quiet groups are candidates for removal.
+
+namespace {
+
+struct LivenessState: public Analyzer::State {
+  long articles = 0;
+  time_t latest = 0;
+
+  void visit(const Article *a) {
+    ++articles;
+    if(a->date() > latest)
+      latest = a->date();
+  }
+
+  void merge(const State &that_) {
+    const LivenessState &that = static_cast<const LivenessState &>(that_);
+    articles += that.articles;
+    if(that.latest > latest)
+      latest = that.latest;
+  }
+};
+
+typedef pair<string, const LivenessState *> Row;
+
+// Order rows by traffic or by age (see --liveness), least active first
+bool before(const Row &a, const Row &b) {
+  if(Config::liveness_by_age) {
+    if(a.second->latest != b.second->latest)
+      return a.second->latest < b.second->latest;
+  } else if(a.second->articles != b.second->articles)
+    return a.second->articles < b.second->articles;
+  return a.first < b.first;
+}
+
+void order(const Analyzer::States &states, vector<Row> &rows) {
+  for(Analyzer::States::const_iterator it = states.begin(); it != states.end();
+      ++it)
+    rows.push_back(
+        Row(it->first, static_cast<const LivenessState *>(it->second)));
+  sort(rows.begin(), rows.end(), before);
+}
+
+void table(ostream &os, const char *heading, const Analyzer::States &states) {
+  vector<Row> rows;
+  order(states, rows);
+  os << "<table class=sortable>\n";
+  HTML::thead(os, heading, "Articles", "Latest", "Age (days)",
+              (const char *)NULL);
+  for(size_t n = 0; n < rows.size(); ++n) {
+    const LivenessState *s = rows[n].second;
+    os << "<tr>\n";
+    os << "<td>" << HTML::Escape(rows[n].first) << "</td>\n";
+    os << "<td sorttable_customkey=" << s->articles << ">" << s->articles
+       << "</td>\n";
+    if(s->latest) {
+      char latest[64];
+      strftime(latest, sizeof latest, "%Y-%m-%d %H:%M", gmtime(&s->latest));
+      const long age = (Config::end_time - s->latest) / 86400;
+      os << "<td sorttable_customkey=" << s->latest << ">" << latest
+         << "</td>\n";
+      os << "<td sorttable_customkey=" << age << ">" << age << "</td>\n";
+    } else
+      os << "<td sorttable_customkey=0>never</td>\n"
+         << "<td sorttable_customkey=" << LONG_MAX << ">-</td>\n";
+    os << "</tr>\n";
+  }
+  os << "</table>\n";
+}
+
+} // namespace
+
+Analyzer::State *LivenessAnalyzer::create() const {
+  return new LivenessState();
+}
+
+Analyzer::State *LivenessAnalyzer::state(long articles, time_t latest) {
+  LivenessState *s = new LivenessState();
+  s->articles = articles;
+  s->latest = latest;
+  return s;
+}
+
+void LivenessAnalyzer::report(const States &groups, const States &hierarchies) {
+  const string csv = Config::output + "/liveness.csv";
+  try {
+    ofstream os(csv.c_str(), ios::trunc);
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    vector<Row> rows;
+    order(groups, rows);
+    for(size_t n = 0; n < rows.size(); ++n)
+      os << csv_quote(rows[n].first) << ',' << rows[n].second->articles << ','
+         << rows[n].second->latest << '\n';
+    os << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", csv.c_str());
+  }
+  const string html = Config::output + "/liveness.html";
+  try {
+    ofstream os(html.c_str());
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    os << HTML::Header("Liveness", "spoolstats.css", "sorttable.js");
+    os << "<h2>Hierarchies</h2>\n";
+    os << "<div>\n";
+    table(os, "Hierarchy", hierarchies);
+    os << "</div>\n";
+    os << "<h2>Groups</h2>\n";
+    os << "<div>\n";
+    table(os, "Group", groups);
+    os << "</div>\n";
+    Config::footer(os);
+    os << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", html.c_str());
+  }
+}
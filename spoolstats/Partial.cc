@@ -0,0 +1,154 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+
+using namespace std;
+
+PartialWriter::PartialWriter(const string &path_, const char *kind):
+    path(path_) {
+  if(!(fp = fopen(path.c_str(), "wb")))
+    fatal(errno, "opening %s", path.c_str());
+  const string magic = PARTIAL_MAGIC(kind);
+  put(magic.data(), magic.size());
+}
+
+PartialWriter::~PartialWriter() {
+  if(fp)
+    fclose(fp);
+}
+
+void PartialWriter::put(const void *ptr, size_t n) {
+  if(fwrite(ptr, 1, n, fp) != n)
+    fatal(errno, "writing to %s", path.c_str());
+}
+
+void PartialWriter::u32(uint32_t n) {
+  unsigned char b[4];
+  for(int i = 0; i < 4; ++i)
+    b[i] = n >> (8 * i);
+  put(b, 4);
+}
+
+void PartialWriter::u64(uint64_t n) {
+  unsigned char b[8];
+  for(int i = 0; i < 8; ++i)
+    b[i] = n >> (8 * i);
+  put(b, 8);
+}
+
+void PartialWriter::str(const string &s) {
+  u32(s.size());
+  put(s.data(), s.size());
+}
+
+void PartialWriter::record(const ArticleRecord &r) {
+  u64(r.mid);
+  u64(r.sender);
+  u32(r.group);
+  u32(r.useragent);
+  u32(r.charset);
+  u32(r.bytes);
+}
+
+long PartialWriter::tell() {
+  const long offset = ftell(fp);
+  if(offset < 0)
+    fatal(errno, "seeking %s", path.c_str());
+  return offset;
+}
+
+void PartialWriter::patch(long offset, uint64_t n) {
+  const long end = tell();
+  if(fseek(fp, offset, SEEK_SET) < 0)
+    fatal(errno, "seeking %s", path.c_str());
+  u64(n);
+  if(fseek(fp, end, SEEK_SET) < 0)
+    fatal(errno, "seeking %s", path.c_str());
+}
+
+void PartialWriter::close(bool sync) {
+  if(fflush(fp) < 0 || ferror(fp))
+    fatal(errno, "writing to %s", path.c_str());
+  if(sync && fsync(fileno(fp)) < 0)
+    fatal(errno, "syncing %s", path.c_str());
+  if(fclose(fp) < 0) {
+    fp = NULL;
+    fatal(errno, "writing to %s", path.c_str());
+  }
+  fp = NULL;
+}
+
+PartialReader::PartialReader(const string &path_, const char *kind_):
+    path(path_), kind(kind_) {
+  if(!(fp = fopen(path.c_str(), "rb")))
+    fatal(errno, "opening %s", path.c_str());
+  const string expected = PARTIAL_MAGIC(kind);
+  string magic(expected.size(), 0);
+  if(fread(&magic[0], 1, magic.size(), fp) != magic.size()
+     || magic != expected)
+    fatal(0, "%s: not a spoolstats %s", path.c_str(), kind);
+}
+
+PartialReader::~PartialReader() {
+  fclose(fp);
+}
+
+void PartialReader::get(void *ptr, size_t n) {
+  if(fread(ptr, 1, n, fp) != n) {
+    if(ferror(fp))
+      fatal(errno, "reading %s", path.c_str());
+    fatal(0, "%s: truncated %s", path.c_str(), kind);
+  }
+}
+
+uint32_t PartialReader::u32() {
+  unsigned char b[4];
+  get(b, 4);
+  uint32_t n = 0;
+  for(int i = 0; i < 4; ++i)
+    n |= (uint32_t)b[i] << (8 * i);
+  return n;
+}
+
+uint64_t PartialReader::u64() {
+  unsigned char b[8];
+  get(b, 8);
+  uint64_t n = 0;
+  for(int i = 0; i < 8; ++i)
+    n |= (uint64_t)b[i] << (8 * i);
+  return n;
+}
+
+string PartialReader::str() {
+  const uint32_t len = u32();
+  string s(len, 0);
+  if(len)
+    get(&s[0], len);
+  return s;
+}
+
+void PartialReader::record(ArticleRecord &r) {
+  r.mid = u64();
+  r.sender = u64();
+  r.group = u32();
+  r.useragent = u32();
+  r.charset = u32();
+  r.bytes = u32();
+}
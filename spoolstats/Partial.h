@@ -0,0 +1,77 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef PARTIAL_H
+#define PARTIAL_H
+
+#include <cstdio>
+
+// Partial results (--emit-partial, --merge) are stored in a simple binary
+// format.  Integers are little-endian regardless of host and strings are a
+// 32-bit length followed by the bytes, so partials can be moved between
+// machines.  Checkpoints (--checkpoint) use the same format with a different
+// KIND, which is recorded in the magic string at the start of the file.
+
+class PartialWriter {
+public:
+  PartialWriter(const std::string &path, const char *kind = "partial");
+  ~PartialWriter();
+
+  void u32(uint32_t n);
+  void u64(uint64_t n);
+  void str(const std::string &s);
+  void record(const ArticleRecord &r);
+
+  // Current offset, and overwrite a u64 at an earlier offset
+  long tell();
+  void patch(long offset, uint64_t n);
+
+  // Flush and close the file, reporting any error.  If SYNC is set then the
+  // contents are also flushed to disk.
+  void close(bool sync = false);
+
+private:
+  std::string path;
+  FILE *fp;
+  void put(const void *ptr, size_t n);
+};
+
+class PartialReader {
+public:
+  PartialReader(const std::string &path, const char *kind = "partial");
+  ~PartialReader();
+
+  uint32_t u32();
+  uint64_t u64();
+  std::string str();
+  void record(ArticleRecord &r);
+
+  const std::string path;
+
+private:
+  const char *kind;
+  FILE *fp;
+  void get(void *ptr, size_t n);
+};
+
+// Identifies partial files; written and checked by the constructors
+#define PARTIAL_MAGIC(kind) ("spoolstats " + std::string(kind) + " 1\n")
+
+#endif /* PARTIAL_H */
@@ -0,0 +1,111 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+
+using namespace std;
+
+// The proportion of articles that are follow-ups (i.e. have a References
+// header).  Groups where hardly anyone follows up aren't hosting
+// conversations.
+
+namespace {
+
+struct ReferencesState: public Analyzer::State {
+  long articles = 0;
+  long references = 0;
+
+  void visit(const Article *a) {
+    ++articles;
+    if(a->references().size())
+      ++references;
+  }
+
+  void merge(const State &that_) {
+    const ReferencesState &that = static_cast<const ReferencesState &>(that_);
+    articles += that.articles;
+    references += that.references;
+  }
+
+  double ratio() const {
+    return articles ? (double)references / articles : 0;
+  }
+};
+
+void table(ostream &os, const char *heading, const Analyzer::States &states) {
+  os << "<table class=sortable>\n";
+  HTML::thead(os, heading, "Articles", "Follow-ups", "Ratio",
+              (const char *)NULL);
+  for(Analyzer::States::const_iterator it = states.begin();
+      it != states.end(); ++it) {
+    const ReferencesState *s = static_cast<const ReferencesState *>(it->second);
+    os << "<tr>\n";
+    os << "<td>" << HTML::Escape(it->first) << "</td>\n";
+    os << "<td sorttable_customkey=-" << s->articles << ">" << s->articles
+       << "</td>\n";
+    os << "<td sorttable_customkey=-" << s->references << ">"
+       << s->references << "</td>\n";
+    os << "<td sorttable_customkey=" << fixed << s->ratio() << ">"
+       << (int)(100 * s->ratio()) << "%</td>\n";
+    os << "</tr>\n";
+  }
+  os << "</table>\n";
+}
+
+} // namespace
+
+Analyzer::State *ReferencesAnalyzer::create() const {
+  return new ReferencesState();
+}
+
+void ReferencesAnalyzer::report(const States &groups,
+                                const States &hierarchies) {
+  const string csv = Config::output + "/references.csv";
+  try {
+    ofstream os(csv.c_str(), ios::trunc);
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    for(States::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+      const ReferencesState *s =
+          static_cast<const ReferencesState *>(it->second);
+      os << csv_quote(it->first) << ',' << s->articles << ','
+         << s->references << '\n';
+    }
+    os << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", csv.c_str());
+  }
+  const string html = Config::output + "/references.html";
+  try {
+    ofstream os(html.c_str());
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    os << HTML::Header("Follow-ups", "spoolstats.css", "sorttable.js");
+    os << "<h2>Hierarchies</h2>\n";
+    os << "<div>\n";
+    table(os, "Hierarchy", hierarchies);
+    os << "</div>\n";
+    os << "<h2>Groups</h2>\n";
+    os << "<div>\n";
+    table(os, "Group", groups);
+    os << "</div>\n";
+    Config::footer(os);
+    os << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", html.c_str());
+  }
+}
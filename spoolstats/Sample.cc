@@ -0,0 +1,72 @@
+/*
+ * spoolstats - news spool stats
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+// Two-sided 95% point of the normal distribution
+static const double z95 = 1.96;
+
+double count_error(double n, double p) {
+  return z95 * sqrt(n * (1 - p)) / p;
+}
+
+double sum_error(double squares, double p) {
+  return z95 * sqrt((1 - p) * squares) / p;
+}
+
+void estimate_distinct(const map<string, int> &counts, double p,
+                       size_t &estimate, double &error) {
+  // f1 and f2 are the number of values seen exactly once and twice.  The
+  // number of unseen values is estimated as in Chao and Lin (2012), which
+  // reduces to Chao1 for small P but, unlike it, to 0 as P approaches 1.
+  // The error is from the bias-corrected Chao1 variance, shrunk in the same
+  // way; it is only approximate.
+  double f1 = 0, f2 = 0;
+  for(map<string, int>::const_iterator it = counts.begin();
+      it != counts.end(); ++it) {
+    if(it->second == 1)
+      ++f1;
+    else if(it->second == 2)
+      ++f2;
+  }
+  const double unseen = f1 && p < 1 ? f1 * f1 / (2 * f2 + p * f1 / (1 - p)) : 0;
+  estimate = counts.size() + llround(unseen);
+  const double g = f2 + 1;
+  const double variance =
+      f1 * (f1 - 1) / (2 * g) + f1 * (2 * f1 - 1) * (2 * f1 - 1) / (4 * g * g)
+      + f1 * f1 * f2 * (f1 - 1) * (f1 - 1) / (4 * g * g * g * g);
+  error = z95 * sqrt(variance * (1 - p));
+}
+
+string plus_minus(double error, bool kilo) {
+  // Errors read back from the logs are shown too
+  if(!Config::sample && !error)
+    return "";
+  ostringstream s;
+  s << " &plusmn;";
+  if(kilo)
+    s << round_kilo(error);
+  else
+    s << fixed << setprecision(error >= 10 ? 0 : 1) << error;
+  return s.str();
+}
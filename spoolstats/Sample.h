@@ -0,0 +1,44 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+// Estimates from a --sample scan.  The errors returned are the half-widths
+// of 95% confidence intervals.
+
+// Error in estimating a count as N/P, having seen N items each sampled with
+// probability P
+double count_error(double n, double p);
+
+// Error in estimating a total as S/P, where SQUARES is the sum of the squares
+// of the sampled values
+double sum_error(double squares, double p);
+
+// Estimate the number of distinct values from the number of times each was
+// seen in a sample taken with probability P
+void estimate_distinct(const std::map<std::string, int> &counts, double p,
+                       size_t &estimate, double &error);
+
+// Error text to follow a value in a report table ("" if there is no error
+// estimate).  If KILO is set then it is formatted as by round_kilo().
+std::string plus_minus(double error, bool kilo = false);
+
+#endif /* SAMPLE_H */
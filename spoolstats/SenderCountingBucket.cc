@@ -32,3 +32,8 @@ void SenderCountingBucket::visit(const Article *a) {
     ++it->second;
   senderCount = senders.size();
 }
+
+void SenderCountingBucket::estimate(double p) {
+  Bucket::estimate(p);
+  estimate_distinct(senders, p, senderCount, senders_error);
+}
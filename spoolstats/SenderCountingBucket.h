@@ -25,13 +25,22 @@ class Article;
 
 class SenderCountingBucket: public Bucket {
 public:
-  SenderCountingBucket(): senderCount(0) {}
+  SenderCountingBucket(): senderCount(0), senders_error(0) {}
   std::map<std::string, int> senders; // sender -> article count
 
   size_t senderCount;
+  double senders_error; // for --sample
+
+  // Scale up counts from a sample taken with probability P
+  void estimate(double p);
 
   // Visit one article
   void visit(const Article *a);
+
+  // Discard the per-sender data, keeping only the counts
+  inline void release() {
+    std::map<std::string, int>().swap(senders);
+  }
 };
 
 #endif /* SENDERCOUNTINGBUCKET_H */
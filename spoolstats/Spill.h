@@ -0,0 +1,266 @@
+//-*-C++-*-
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <cstdlib>
+#include <unistd.h>
+
+// Sort an arbitrarily large number of fixed-size records in bounded memory.
+// Records are buffered until the limit is reached, then sorted and written
+// to an anonymous temporary file (a "run").  merge() delivers every record in
+// ascending order via a k-way merge of the runs.
+//
+// T must be trivially copyable and have an operator<.
+template <typename T> class ExternalSorter {
+public:
+  // Spill to DIR whenever MEMORY bytes of records are buffered.  If MEMORY is
+  // 0 then everything is kept in memory.
+  ExternalSorter(const std::string &dir_, size_t memory):
+      dir(dir_),
+      limit(memory ? std::max<size_t>(memory / sizeof(T), 256) : SIZE_MAX) {}
+
+  ~ExternalSorter() {
+    for(size_t n = 0; n < runs.size(); ++n)
+      close(runs[n]);
+  }
+
+  // Add one record
+  void add(const T &t) {
+    if(buffer.size() == buffer.capacity())
+      buffer.reserve(
+          std::min(limit, std::max<size_t>(1024, 2 * buffer.capacity())));
+    buffer.push_back(t);
+    if(buffer.size() >= limit)
+      spill();
+  }
+
+  // Number of runs written so far
+  size_t spilled() const {
+    return nspilled;
+  }
+
+  // Call F for every record in ascending order.  The sorter is empty
+  // afterwards.
+  template <typename F> void merge(F f) {
+    if(runs.empty()) {
+      std::sort(buffer.begin(), buffer.end());
+      for(size_t n = 0; n < buffer.size(); ++n)
+        f(buffer[n]);
+      std::vector<T>().swap(buffer);
+    } else {
+      if(buffer.size())
+        spill();
+      std::vector<T>().swap(buffer);
+      std::vector<int> in;
+      in.swap(runs);
+      merge_runs(in, f);
+    }
+  }
+
+private:
+  std::string dir;
+  size_t limit;            // maximum records in memory
+  std::vector<T> buffer;   // records not yet spilled
+  std::vector<int> runs;   // file descriptors of sorted runs
+  size_t nspilled = 0;
+
+  // Maximum number of runs to merge in one go.  If more accumulate they are
+  // merged into a single run, to bound the number of open files.
+  static const size_t max_runs = 64;
+
+  // One run being read back
+  struct Reader {
+    int fd;
+    off_t offset = 0;
+    std::vector<T> records;
+    size_t pos = 0;
+  };
+
+  // Write out the buffer as a new run
+  void spill() {
+    std::sort(buffer.begin(), buffer.end());
+    const int fd = create();
+    write_records(fd, buffer.data(), buffer.size());
+    buffer.clear();
+    runs.push_back(fd);
+    ++nspilled;
+    if(runs.size() >= max_runs) {
+      // The buffer's memory is lent to the merge
+      std::vector<T>().swap(buffer);
+      std::vector<int> in;
+      in.swap(runs);
+      const int out = create();
+      std::vector<T> pending;
+      pending.reserve(std::max<size_t>(limit / (max_runs + 1), 256));
+      merge_runs(in, [&](const T &t) {
+        pending.push_back(t);
+        if(pending.size() == pending.capacity()) {
+          write_records(out, pending.data(), pending.size());
+          pending.clear();
+        }
+      });
+      write_records(out, pending.data(), pending.size());
+      runs.push_back(out);
+    }
+  }
+
+  // Merge the runs IN, calling F for each record, and close them
+  template <typename F> void merge_runs(std::vector<int> &in, F f) {
+    const size_t chunk = std::max<size_t>(limit / (in.size() + 1), 256);
+    std::vector<Reader> readers(in.size());
+    typedef std::pair<T, size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    for(size_t n = 0; n < in.size(); ++n) {
+      readers[n].fd = in[n];
+      readers[n].records.resize(chunk);
+      if(fill(readers[n]))
+        heap.push(Entry(readers[n].records[readers[n].pos++], n));
+    }
+    while(!heap.empty()) {
+      const Entry e = heap.top();
+      heap.pop();
+      f(e.first);
+      Reader &r = readers[e.second];
+      if(r.pos < r.records.size() || fill(r))
+        heap.push(Entry(r.records[r.pos++], e.second));
+    }
+    for(size_t n = 0; n < in.size(); ++n)
+      close(in[n]);
+    in.clear();
+  }
+
+  // Refill a reader's buffer.  Returns false at end of file.
+  bool fill(Reader &r) {
+    r.records.resize(r.records.capacity());
+    char *const base = (char *)r.records.data();
+    const size_t want = r.records.size() * sizeof(T);
+    size_t got = 0;
+    while(got < want) {
+      const ssize_t n = pread(r.fd, base + got, want - got, r.offset + got);
+      if(n < 0) {
+        if(errno == EINTR)
+          continue;
+        fatal(errno, "reading temporary file in %s", dir.c_str());
+      }
+      if(n == 0)
+        break;
+      got += n;
+    }
+    if(got % sizeof(T))
+      fatal(0, "truncated temporary file in %s", dir.c_str());
+    r.offset += got;
+    r.records.resize(got / sizeof(T));
+    r.pos = 0;
+    return got > 0;
+  }
+
+  // Create an anonymous temporary file
+  int create() {
+    std::string path = dir + "/spoolstats.XXXXXX";
+    const int fd = mkstemp(&path[0]);
+    if(fd < 0)
+      fatal(errno, "creating temporary file in %s", dir.c_str());
+    if(unlink(path.c_str()) < 0)
+      fatal(errno, "removing %s", path.c_str());
+    return fd;
+  }
+
+  // Append N records to FD
+  void write_records(int fd, const T *records, size_t n) {
+    const char *ptr = (const char *)records;
+    size_t left = n * sizeof(T);
+    while(left) {
+      const ssize_t written = write(fd, ptr, left);
+      if(written < 0) {
+        if(errno == EINTR)
+          continue;
+        fatal(errno, "writing temporary file in %s", dir.c_str());
+      }
+      ptr += written;
+      left -= written;
+    }
+  }
+};
+
+// Map strings to small integers and back
+class Interner {
+public:
+  uint32_t intern(const std::string &s) {
+    std::map<std::string, uint32_t>::const_iterator it = ids.find(s);
+    if(it != ids.end())
+      return it->second;
+    const uint32_t id = names.size();
+    ids.insert(std::pair<std::string, uint32_t>(s, id));
+    names.push_back(s);
+    return id;
+  }
+
+  const std::string &name(uint32_t id) const {
+    return names.at(id);
+  }
+
+  size_t size() const {
+    return names.size();
+  }
+
+private:
+  std::map<std::string, uint32_t> ids;
+  std::vector<std::string> names;
+};
+
+// What external-memory mode records about an article.  There is one record
+// with group=0 for the article as a whole and one for each wanted group it
+// appears in.
+struct ArticleRecord {
+  uint64_t mid;       // hash of Message-ID
+  uint64_t sender;    // hash of sender
+  uint32_t group;     // 0 or 1 + group ID
+  uint32_t useragent; // interned user agent
+  uint32_t charset;   // interned character encoding
+  uint32_t bytes;     // size of article
+
+  bool operator<(const ArticleRecord &that) const {
+    if(mid != that.mid)
+      return mid < that.mid;
+    return group < that.group;
+  }
+};
+
+// A sender seen in some scope (a group, hierarchy or property value)
+struct SenderRecord {
+  uint32_t kind;
+  uint32_t id;
+  uint64_t sender;
+
+  bool operator<(const SenderRecord &that) const {
+    if(kind != that.kind)
+      return kind < that.kind;
+    if(id != that.id)
+      return id < that.id;
+    return sender < that.sender;
+  }
+};
+
+#endif /* SPILL_H */
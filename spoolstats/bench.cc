@@ -0,0 +1,442 @@
+/*
+ * This file is part of rjk-nntp-tools.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA
+ */
+#include "spoolstats.h"
+#include "listdir.h"
+extern "C" {
+#include "io.h"
+#include "seen.h"
+}
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <ctime>
+#include <streambuf>
+
+using namespace std;
+
+// Allocation counting ---------------------------------------------------------
+
+static unsigned long allocations;
+
+#if __GLIBC__
+// Interpose the malloc family so that allocations from both C and C++ code are
+// counted.  operator new is implemented in terms of malloc.
+extern "C" {
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *malloc(size_t n) noexcept {
+  ++allocations;
+  return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t s) noexcept {
+  ++allocations;
+  return __libc_calloc(n, s);
+}
+
+void *realloc(void *ptr, size_t n) noexcept {
+  ++allocations;
+  return __libc_realloc(ptr, n);
+}
+}
+#else
+// Elsewhere only C++ allocations are counted
+void *operator new(size_t n) {
+  ++allocations;
+  if(void *ptr = malloc(n ? n : 1))
+    return ptr;
+  throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+#endif
+
+// Corpus ----------------------------------------------------------------------
+
+static string corpus = BENCH_CORPUS;
+static vector<string> article_texts;
+static vector<Article *> articles;
+static vector<string> dates;
+static vector<string> newsgroups;
+static vector<string> useragents;
+static vector<string> commits;
+static string lines_path;
+static const char *seen_path = "bench.seen";
+
+// Read a whole file
+static string slurp(const string &path) {
+  vector<string> lines;
+  read_file(path, lines);
+  string s;
+  for(size_t n = 0; n < lines.size(); ++n)
+    s += lines[n];
+  return s;
+}
+
+// Read a file as a list of lines without their newlines
+static void lines(const string &path, vector<string> &v) {
+  read_file(path, v);
+  for(size_t n = 0; n < v.size(); ++n)
+    if(v[n].size() && v[n][v[n].size() - 1] == '\n')
+      v[n].erase(v[n].size() - 1);
+}
+
+static void load_corpus() {
+  vector<string> names;
+  list_directory(corpus + "/articles", names,
+                 [](const string &name) { return name[0] != '.'; });
+  sort(names.begin(), names.end());
+  for(size_t n = 0; n < names.size(); ++n) {
+    article_texts.push_back(slurp(corpus + "/articles/" + names[n]));
+    const string &text = article_texts.back();
+    Article *a = new Article(text, text.size());
+    if(!a->valid())
+      fatal(0, "%s/articles/%s: invalid article", corpus.c_str(),
+            names[n].c_str());
+    articles.push_back(a);
+    vector<string> groups;
+    const size_t ngroups = a->get_groups(groups);
+    string ng;
+    for(size_t m = 0; m < ngroups; ++m)
+      ng += (m ? "," : "") + groups[m];
+    newsgroups.push_back(ng);
+  }
+  if(articles.empty())
+    fatal(0, "no articles in %s/articles", corpus.c_str());
+  lines(corpus + "/dates", dates);
+  lines(corpus + "/useragents", useragents);
+  lines(corpus + "/commits", commits);
+  // io_getline() gets a file of all the article texts
+  char tmp[] = "bench.lines.XXXXXX";
+  int fd = mkstemp(tmp);
+  if(fd < 0)
+    fatal(errno, "mkstemp");
+  for(size_t n = 0; n < article_texts.size(); ++n)
+    if(write(fd, article_texts[n].data(), article_texts[n].size()) < 0)
+      fatal(errno, "writing %s", tmp);
+  if(close(fd) < 0)
+    fatal(errno, "closing %s", tmp);
+  lines_path = tmp;
+}
+
+// Benchmarks ------------------------------------------------------------------
+//
+// Each benchmark performs one pass over its corpus and returns the number of
+// operations it performed.
+
+static size_t bench_article_parse() {
+  static Article a; // reused, as in AllGroups::visit()
+  for(size_t n = 0; n < article_texts.size(); ++n) {
+    a.parse(article_texts[n].data(), article_texts[n].size(),
+            article_texts[n].size());
+    if(!a.valid())
+      abort();
+  }
+  return article_texts.size();
+}
+
+static size_t bench_article_charset() {
+  size_t total = 0;
+  for(size_t n = 0; n < articles.size(); ++n)
+    total += articles[n]->charset().size();
+  if(!total)
+    abort();
+  return articles.size();
+}
+
+static size_t bench_parse_date() {
+  time_t total = 0;
+  for(size_t n = 0; n < dates.size(); ++n)
+    total += parse_date(dates[n]);
+  if(!total)
+    abort();
+  return dates.size();
+}
+
+static size_t bench_split() {
+  for(size_t n = 0; n < newsgroups.size(); ++n) {
+    vector<string> bits;
+    split(bits, ',', newsgroups[n]);
+  }
+  return newsgroups.size();
+}
+
+static size_t bench_read_csv() {
+  vector<vector<Value>> rows;
+  read_csv(corpus + "/groups.csv", rows);
+  return rows.size();
+}
+
+static size_t bench_csv_quote() {
+  size_t total = 0;
+  for(size_t n = 0; n < useragents.size(); ++n)
+    total += csv_quote(useragents[n]).size();
+  if(!total)
+    abort();
+  return useragents.size();
+}
+
+// A stream buffer that discards its input, so that only the escaping is timed
+class NullBuffer: public streambuf {
+protected:
+  int overflow(int c) {
+    return c;
+  }
+  streamsize xsputn(const char *, streamsize n) {
+    return n;
+  }
+};
+
+static size_t bench_html_escape() {
+  static NullBuffer nb;
+  static ostream os(&nb);
+  for(size_t n = 0; n < useragents.size(); ++n)
+    os << HTML::Escape(useragents[n]);
+  return useragents.size();
+}
+
+static size_t bench_summarize() {
+  size_t total = 0;
+  for(size_t n = 0; n < useragents.size(); ++n)
+    total += AllGroups::summarize(useragents[n]).size();
+  if(!total)
+    abort();
+  return useragents.size();
+}
+
+static size_t bench_remember() {
+  remove(seen_path);
+  init_seen(seen_path);
+  for(size_t n = 0; n < commits.size(); ++n)
+    remember(commits[n].c_str());
+  return commits.size();
+}
+
+static size_t bench_seen() {
+  static bool initialized;
+  if(!initialized) {
+    bench_remember();
+    initialized = true;
+  }
+  for(size_t n = 0; n < commits.size(); ++n)
+    if(!seen(commits[n].c_str()))
+      abort();
+  return commits.size();
+}
+
+static size_t bench_io_getline() {
+  int fd = open(lines_path.c_str(), O_RDONLY);
+  if(fd < 0)
+    fatal(errno, "opening %s", lines_path.c_str());
+  IO *io = io_create(fd);
+  char *line = NULL;
+  size_t linesize = 0, count = 0;
+  int rc;
+  while(!(rc = io_getline(io, &line, &linesize)))
+    ++count;
+  if(rc > 0)
+    fatal(rc, "reading %s", lines_path.c_str());
+  free(line);
+  io_close(io);
+  return count;
+}
+
+static const struct benchmark {
+  const char *name;
+  size_t (*run)();
+} benchmarks[] = {
+    {"article-parse", bench_article_parse},
+    {"article-charset", bench_article_charset},
+    {"parse-date", bench_parse_date},
+    {"split", bench_split},
+    {"read-csv", bench_read_csv},
+    {"csv-quote", bench_csv_quote},
+    {"html-escape", bench_html_escape},
+    {"summarize", bench_summarize},
+    {"seen", bench_seen},
+    {"remember", bench_remember},
+    {"io-getline", bench_io_getline},
+};
+
+#define NBENCHMARKS (sizeof benchmarks / sizeof *benchmarks)
+
+// Measurement -----------------------------------------------------------------
+
+struct result {
+  double ns;     // nanoseconds per operation
+  double allocs; // allocations per operation
+};
+
+static double min_time = 0.25;
+static int repeats = 3;
+
+static double now() {
+  struct timespec ts;
+  if(clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+    fatal(errno, "clock_gettime");
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Run one benchmark for at least min_time seconds, repeats times, and report
+// the fastest.  Allocation counts are deterministic so any run will do.
+static result measure(const benchmark &b) {
+  result best = {0, 0};
+  b.run(); // warm up
+  for(int r = 0; r < repeats; ++r) {
+    size_t ops = 0;
+    unsigned long before = allocations;
+    double start = now(), elapsed;
+    do {
+      ops += b.run();
+    } while((elapsed = now() - start) < min_time);
+    double ns = elapsed * 1e9 / ops;
+    if(r == 0 || ns < best.ns)
+      best.ns = ns;
+    best.allocs = (double)(allocations - before) / ops;
+  }
+  return best;
+}
+
+// Baselines -------------------------------------------------------------------
+
+static void save(const string &path, const map<string, result> &results) {
+  try {
+    ofstream os(path.c_str(), ios::trunc);
+    os.exceptions(ofstream::badbit | ofstream::failbit);
+    for(auto it = results.begin(); it != results.end(); ++it)
+      os << it->first << ' ' << fixed << setprecision(2) << it->second.ns << ' '
+         << it->second.allocs << '\n';
+    os << flush;
+  } catch(ios::failure &) {
+    fatal(errno, "writing to %s", path.c_str());
+  }
+}
+
+// Compare against a baseline.  Returns the number of regressions.
+static int compare(const string &path, const map<string, result> &results,
+                   double threshold) {
+  vector<string> baseline;
+  int regressions = 0;
+  lines(path, baseline);
+  for(size_t n = 0; n < baseline.size(); ++n) {
+    char name[128];
+    result base;
+    if(sscanf(baseline[n].c_str(), "%127s %lf %lf", name, &base.ns,
+              &base.allocs)
+       != 3)
+      fatal(0, "%s:%zu: malformed baseline", path.c_str(), n + 1);
+    auto it = results.find(name);
+    if(it == results.end())
+      continue;
+    const result &r = it->second;
+    const double limit = 1 + threshold / 100;
+    bool slower = r.ns > base.ns * limit;
+    bool fatter = r.allocs > base.allocs * limit + 0.005;
+    if(slower || fatter) {
+      printf("REGRESSION %s: %.2f ns/op (was %.2f), %.2f allocs/op (was %.2f)\n",
+             name, r.ns, base.ns, r.allocs, base.allocs);
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  static const struct option options[] = {
+      {"corpus", required_argument, 0, 'C'},
+      {"time", required_argument, 0, 't'},
+      {"repeat", required_argument, 0, 'r'},
+      {"save", required_argument, 0, 's'},
+      {"compare", required_argument, 0, 'c'},
+      {"threshold", required_argument, 0, 'T'},
+      {"help", no_argument, 0, 'h'},
+      {"version", no_argument, 0, 'V'},
+      {0, 0, 0, 0}};
+  string save_path, compare_path;
+  double threshold = 10;
+  int n;
+
+  while((n = getopt_long(argc, argv, "hVC:t:r:s:c:T:", options, 0)) >= 0) {
+    switch(n) {
+    case 'h':
+      printf("Usage:\n\
+  bench [OPTIONS] [BENCHMARK...]\n\
+\n\
+Options:\n\
+  -C, --corpus DIR                  Corpus directory\n\
+  -t, --time SECONDS                Minimum time per measurement (default 0.25)\n\
+  -r, --repeat COUNT                Measurements per benchmark (default 3)\n\
+  -s, --save PATH                   Save results as a baseline\n\
+  -c, --compare PATH                Compare results against a baseline\n\
+  -T, --threshold PERCENT           Permitted regression (default 10)\n\
+  -h, --help                        Display usage message\n\
+  -V, --version                     Display version number\n");
+      return 0;
+    case 'V':
+      printf("bench from rjk-nntp-tools version " VERSION "\n");
+      return 0;
+    case 'C': corpus = optarg; break;
+    case 't':
+      if((min_time = atof(optarg)) <= 0)
+        fatal(0, "--time must be positive");
+      break;
+    case 'r':
+      if((repeats = atoi(optarg)) <= 0)
+        fatal(0, "--repeat must be positive");
+      break;
+    case 's': save_path = optarg; break;
+    case 'c': compare_path = optarg; break;
+    case 'T':
+      if((threshold = atof(optarg)) < 0)
+        fatal(0, "--threshold must not be negative");
+      break;
+    default: return 1;
+    }
+  }
+  load_corpus();
+  map<string, result> results;
+  printf("%-20s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+  for(size_t b = 0; b < NBENCHMARKS; ++b) {
+    if(optind < argc) {
+      int m;
+      for(m = optind; m < argc; ++m)
+        if(!strcmp(argv[m], benchmarks[b].name))
+          break;
+      if(m == argc)
+        continue;
+    }
+    const result r = measure(benchmarks[b]);
+    results[benchmarks[b].name] = r;
+    printf("%-20s %12.2f %12.2f\n", benchmarks[b].name, r.ns, r.allocs);
+    fflush(stdout);
+  }
+  remove(seen_path);
+  remove(lines_path.c_str());
+  if(save_path.size())
+    save(save_path, results);
+  if(compare_path.size() && compare(compare_path, results, threshold))
+    return 1;
+  return 0;
+}
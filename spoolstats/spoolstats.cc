@@ -40,20 +40,54 @@ int main(int argc, char **argv) {
   // Become the right user
   if(Config::user.size())
     become(Config::user.c_str());
+  if(Config::background)
+    background();
   // Scan everything
-  AllGroups all;
-  if(Config::scan) {
-    all.scan();
-    all.logs();
-  } else
-    all.readLogs();
-  if(Config::graph) {
-    // Generate  report
-    all.graphs();
-    all.report();
-    // Auxiliary files
+  if(Config::liveness) {
+    liveness();
     extrafile("sorttable.js", sorttable_js, sorttable_js_len);
     extrafile("spoolstats.css", spoolstats_css, spoolstats_css_len);
+    return 0;
+  }
+  AllGroups all(Config::start_time);
+  // Shorter windows are fed from the scan of the longest
+  vector<AllGroups *> windows(1, &all);
+  for(size_t n = 1; n < Config::windows.size(); ++n) {
+    windows.push_back(
+        new AllGroups(Config::end_time - 86400 * Config::windows[n], true));
+    all.route(windows.back());
+  }
+  if(Config::partials.size())
+    all.merge(Config::partials);
+  else if(Config::scan)
+    all.scan();
+  else
+    for(size_t n = 0; n < windows.size(); ++n) {
+      Config::select(n);
+      windows[n]->readLogs();
+    }
+  if(Config::emit_partial.size()) {
+    // Logs and reports are left to whoever merges the partials
+    all.emit(Config::emit_partial);
+    return 0;
+  }
+  for(size_t n = 0; n < windows.size(); ++n) {
+    Config::select(n);
+    if(Config::scan) {
+      windows[n]->logs();
+      windows[n]->analyses();
+    }
+    if(Config::graph) {
+      // Generate  report
+      windows[n]->graphs();
+      windows[n]->report();
+      // Auxiliary files
+      extrafile("sorttable.js", sorttable_js, sorttable_js_len);
+      extrafile("spoolstats.css", spoolstats_css, spoolstats_css_len);
+    }
   }
+  // Everything was written (or we would have exited), so an interrupted
+  // scan need no longer be resumed
+  all.forget_checkpoint();
   return 0;
 }
@@ -31,20 +31,31 @@
 #include <fstream>
 #include <cstring>
 #include <cerrno>
+#include <thread>
+#include <sys/types.h>
 
 #include "utils.h"
 #include "cpputils.h"
+#include "readorder.h"
 #include "ArticleProperty.h"
 #include "Article.h"
 #include "Bucket.h"
 #include "SenderCountingBucket.h"
+#include "Spill.h"
+#include "Directory.h"
+#include "Background.h"
+#include "Sample.h"
+#include "Analyzer.h"
 #include "AllGroups.h"
+#include "Partial.h"
 #include "Hierarchy.h"
 #include "Group.h"
 #include "Conf.h"
 #include "HTML.h"
 #include "TimeGraph.h"
 #include "User.h"
+#include "Active.h"
+#include "Liveness.h"
 
 extern "C" const char sorttable[];
 extern "C" const char css[];